@@ -1,4 +1,11 @@
 #include <stdio.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __linux__
+  #include <unistd.h>
+  #include <sys/wait.h>
+#endif
 #include "bench.h"
 #include "nodes.h"
 #include "net.h"
@@ -6,6 +13,11 @@
 #include "go.h"
 #include "tt.h"
 #include "position.h"
+#include "move.h"
+#include "search.h"
+#include "qsearch.h"
+#include "profile.h"
+#include "bitboard.h"
 
 typedef struct {
 
@@ -71,36 +83,623 @@ static const BenchTest bench_data[] = {
 
 };
 
-void bench (int depth) {
+extern int num_threads;
 
-  const int num_fens = 50;
-  uint64_t start_ms = time_ms();
-  uint64_t total_nodes = 0;
+// set up nodes[0] at bench position i
+void bench_position (const int i) {
 
-  for (int i=0; i < num_fens; i++) {
+  const BenchTest *b = &bench_data[i];
 
-    const BenchTest *b = &bench_data[i];
+  position(&nodes[0], b->fen, b->stm, b->rights, b->ep, 0, 0, NULL);
+
+}
+
+typedef struct {
+
+  uint64_t nodes[BENCH_FENS];
+  uint64_t us[BENCH_FENS];
+  move_t best[BENCH_FENS];
+  uint64_t total_nodes;
+  uint64_t total_us;
+
+} BenchRun;
+
+// search every bench position to depth with the given thread count
+static void bench_run (const int depth, const int threads, BenchRun *r) {
+
+  const int saved_threads = num_threads;
+
+  num_threads = threads;
+  r->total_nodes = 0;
+  r->total_us = 0;
+
+  for (int i=0; i < BENCH_FENS; i++) {
 
     new_game();
-    position(&nodes[0], b->fen, b->stm, b->rights, b->ep, 0, 0, NULL);
+    bench_position(i);
     init_tc(0, 0, 0, 0, 0, 0, depth, 0);
+
+    // nodes are flushed to the tc in batches; count what this thread still
+    // holds too so a position's count does not depend on the one before
+    const int batched = search_local_node_batch + qsearch_local_node_batch;
+    const uint64_t start_us = time_us();
     go(1);
+    r->us[i] = time_us() - start_us;
+    r->nodes[i] = thread_tc->nodes + search_local_node_batch + qsearch_local_node_batch - batched;
+    r->best[i] = thread_tc->best_move;
+
+    r->total_nodes += r->nodes[i];
+    r->total_us += r->us[i];
+
+  }
+
+  num_threads = saved_threads;
+
+}
+
+static uint64_t bench_nps (const uint64_t nodes, const uint64_t us) {
+
+  return (nodes * 1000000ULL) / (us ? us : 1);
+
+}
+
+// a hash size runs the bench on a private tt and histories, leaving the
+// uci state alone; threads < 1 uses the uci thread count
 
-    total_nodes += time_control.nodes;
+void bench (int depth, int threads, int hash_mb) {
 
+  static BenchRun r;
+
+  if (threads < 1)
+    threads = num_threads;
+  if (threads > 256)
+    threads = 256;
+
+  if (hash_mb > 0 && go_private_init(hash_mb)) {
+    printf("error: cannot allocate %d MB for bench\n", hash_mb);
+    return;
   }
 
-  uint64_t end_ms = time_ms();
-  uint64_t elapsed_ms = end_ms - start_ms;
-  uint64_t nps = (total_nodes * 1000ULL) / (elapsed_ms ? elapsed_ms : 1);
+  uint64_t start_ms = time_ms();
+
+  bench_run(depth, threads, &r);
+
+  uint64_t elapsed_ms = time_ms() - start_ms;
+  uint64_t nps = (r.total_nodes * 1000ULL) / (elapsed_ms ? elapsed_ms : 1);
+
+  if (hash_mb > 0)
+    go_private_free();
 
   printf("nodes %llu elapsed %llu nps %llu\n", 
-    (unsigned long long)total_nodes,
+    (unsigned long long)r.total_nodes,
     (unsigned long long)elapsed_ms,
     (unsigned long long)nps);
 
 }
 
+// run the bench at 1, 2, 4 ... max_threads threads and compare each run
+// with the single threaded one; at a fixed depth the time to depth ratio
+// is the effective speedup, while the nps ratio includes the extra nodes
+// helpers search, so a widening gap means the threads are duplicating work
+
+void bench_scale (int depth, int max_threads, int hash_mb) {
+
+  static BenchRun base, r;
+
+  if (max_threads < 1)
+    max_threads = num_threads;
+  if (max_threads > 256)
+    max_threads = 256;
+  if (hash_mb < 1)
+    hash_mb = TT_DEFAULT_MB;
+
+  if (go_private_init(hash_mb)) {
+    printf("error: cannot allocate %d MB for bench\n", hash_mb);
+    return;
+  }
+
+  printf("bench: depth %d threads %d hash %d\n", depth, max_threads, hash_mb);
+  printf("%7s %12s %9s %11s %7s %7s %7s %7s %7s %7s\n",
+    "threads", "nodes", "ttd ms", "nps", "nps x", "ttd x", "mean x", "sd x", "min x", "max x");
+
+  for (int t=1; t <= max_threads; t = (t < max_threads && t * 2 > max_threads) ? max_threads : t * 2) {
+
+    bench_run(depth, t, t == 1 ? &base : &r);
+
+    const BenchRun *cur = t == 1 ? &base : &r;
+
+    // per position time to depth speedup against 1 thread
+    double sum = 0, sum_sq = 0, lo = 1e9, hi = 0;
+
+    for (int i=0; i < BENCH_FENS; i++) {
+
+      const double x = (double)(base.us[i] ? base.us[i] : 1) / (double)(cur->us[i] ? cur->us[i] : 1);
+
+      sum += x;
+      sum_sq += x * x;
+      if (x < lo) lo = x;
+      if (x > hi) hi = x;
+
+    }
+
+    const double mean = sum / BENCH_FENS;
+    const double var = sum_sq / BENCH_FENS - mean * mean;
+    const uint64_t nps = bench_nps(cur->total_nodes, cur->total_us);
+
+    printf("%7d %12llu %9.0f %11llu %7.2f %7.2f %7.2f %7.2f %7.2f %7.2f\n",
+      t,
+      (unsigned long long)cur->total_nodes,
+      cur->total_us / 1000.0,
+      (unsigned long long)nps,
+      (double)nps / (double)bench_nps(base.total_nodes, base.total_us),
+      (double)base.total_us / (double)(cur->total_us ? cur->total_us : 1),
+      mean,
+      var > 0 ? sqrt(var) : 0.0,
+      lo,
+      hi);
+
+    fflush(stdout);
+
+  }
+
+  go_private_free();
+
+}
+
+// bench with every search thread counting its hardware events; misses are
+// per thousand instructions so positions and threads compare directly
+
+void bench_profile (int depth, int threads) {
+
+  static BenchRun r;
+  static ProfCounts pos_counts[BENCH_FENS];
+  ProfSet probe;
+
+  if (threads < 1)
+    threads = num_threads;
+  if (threads > PROF_MAX_THREADS)
+    threads = PROF_MAX_THREADS;
+
+  if (prof_open(&probe)) {
+    printf("error: perf_event_open failed, check kernel.perf_event_paranoid\n");
+    return;
+  }
+  prof_close(&probe);
+
+  if (go_private_init(TT_DEFAULT_MB)) {
+    printf("error: cannot allocate %d MB for bench\n", TT_DEFAULT_MB);
+    return;
+  }
+
+  const int saved_threads = num_threads;
+
+  num_threads = threads;
+  prof_threads = 1;
+  memset(prof_thread_counts, 0, sizeof(prof_thread_counts));
+
+  printf("profile: depth %d threads %d, misses per 1k instructions\n", depth, threads);
+  printf("%3s %10s %10s %8s", "pos", "nodes", "nps", "cyc/node");
+  prof_header();
+  printf("\n");
+
+  r.total_nodes = 0;
+  r.total_us = 0;
+
+  for (int i=0; i < BENCH_FENS; i++) {
+
+    ProfCounts before = {0}, *c = &pos_counts[i];
+
+    for (int t=0; t < threads; t++)
+      prof_add(&before, &prof_thread_counts[t]);
+
+    new_game();
+    bench_position(i);
+    init_tc(0, 0, 0, 0, 0, 0, depth, 0);
+
+    const int batched = search_local_node_batch + qsearch_local_node_batch;
+    const uint64_t start_us = time_us();
+    go(1);
+    r.us[i] = time_us() - start_us;
+    r.nodes[i] = thread_tc->nodes + search_local_node_batch + qsearch_local_node_batch - batched;
+    r.total_nodes += r.nodes[i];
+    r.total_us += r.us[i];
+
+    memset(c, 0, sizeof(ProfCounts));
+    for (int t=0; t < threads; t++)
+      prof_add(c, &prof_thread_counts[t]);
+    prof_sub(c, &before);
+
+    printf("%3d %10llu %10llu %8.0f", i,
+      (unsigned long long)r.nodes[i],
+      (unsigned long long)bench_nps(r.nodes[i], r.us[i]),
+      (double)c->v[PROF_CYCLES] / (double)(r.nodes[i] ? r.nodes[i] : 1));
+    prof_print(c, c->v[PROF_INSTRUCTIONS] / 1000.0);
+    printf("\n");
+
+  }
+
+  printf("%6s %10s %10s %8s", "thread", "cycles", "instr", "share");
+  prof_header();
+  printf("\n");
+
+  ProfCounts total = {0};
+
+  for (int t=0; t < threads; t++)
+    prof_add(&total, &prof_thread_counts[t]);
+
+  for (int t=0; t < threads; t++) {
+    const ProfCounts *c = &prof_thread_counts[t];
+    printf("%6d %10.3g %10.3g %7.1f%%", t,
+      (double)c->v[PROF_CYCLES],
+      (double)c->v[PROF_INSTRUCTIONS],
+      100.0 * c->v[PROF_CYCLES] / (double)(total.v[PROF_CYCLES] ? total.v[PROF_CYCLES] : 1));
+    prof_print(c, c->v[PROF_INSTRUCTIONS] / 1000.0);
+    printf("\n");
+  }
+
+  printf("%6s %10.3g %10.3g %8s", "all", (double)total.v[PROF_CYCLES], (double)total.v[PROF_INSTRUCTIONS], "");
+  prof_print(&total, total.v[PROF_INSTRUCTIONS] / 1000.0);
+  printf("\n");
+
+  printf("nodes %llu nps %llu cyc/node %.0f\n",
+    (unsigned long long)r.total_nodes,
+    (unsigned long long)bench_nps(r.total_nodes, r.total_us),
+    (double)total.v[PROF_CYCLES] / (double)(r.total_nodes ? r.total_nodes : 1));
+  prof_coverage(&total);
+
+  prof_threads = 0;
+  num_threads = saved_threads;
+
+  go_private_free();
+
+}
+
+// isa extensions the build targets and the ones this cpu has
+
+static void bench_features (char *build, char *cpu, const size_t size) {
+
+  build[0] = 0;
+  cpu[0] = 0;
+
+#ifdef __AVX512F__
+  strncat(build, "avx512f ", size - strlen(build) - 1);
+#endif
+#ifdef __AVX512BW__
+  strncat(build, "avx512bw ", size - strlen(build) - 1);
+#endif
+#ifdef __AVX2__
+  strncat(build, "avx2 ", size - strlen(build) - 1);
+#endif
+#ifdef __BMI2__
+  strncat(build, "bmi2 ", size - strlen(build) - 1);
+#endif
+#ifdef __POPCNT__
+  strncat(build, "popcnt ", size - strlen(build) - 1);
+#endif
+#ifdef __SSE4_1__
+  strncat(build, "sse4.1 ", size - strlen(build) - 1);
+#endif
+#ifdef __ARM_NEON
+  strncat(build, "neon ", size - strlen(build) - 1);
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f"))  strncat(cpu, "avx512f ", size - strlen(cpu) - 1);
+  if (__builtin_cpu_supports("avx512bw")) strncat(cpu, "avx512bw ", size - strlen(cpu) - 1);
+  if (__builtin_cpu_supports("avx2"))     strncat(cpu, "avx2 ", size - strlen(cpu) - 1);
+  if (__builtin_cpu_supports("bmi2"))     strncat(cpu, "bmi2 ", size - strlen(cpu) - 1);
+  if (__builtin_cpu_supports("popcnt"))   strncat(cpu, "popcnt ", size - strlen(cpu) - 1);
+  if (__builtin_cpu_supports("sse4.1"))   strncat(cpu, "sse4.1 ", size - strlen(cpu) - 1);
+#endif
+
+  if (build[0]) build[strlen(build) - 1] = 0;
+  if (cpu[0]) cpu[strlen(cpu) - 1] = 0;
+
+}
+
+static void json_string (const char *str) {
+
+  putchar('"');
+  for (; *str; str++) {
+    if (*str == '"' || *str == '\\')
+      putchar('\\');
+    putchar(*str);
+  }
+  putchar('"');
+
+}
+
+// two sided 95% student t for n - 1 degrees of freedom
+static double bench_t95 (const int n) {
+
+  static const double t[] = {
+    12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+    2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+    2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+  };
+
+  if (n < 2)
+    return 0;
+  if (n - 1 <= 30)
+    return t[n - 2];
+  return 1.960;
+
+}
+
+static int cmp_double (const void *a, const void *b) {
+
+  const double x = *(const double *)a;
+  const double y = *(const double *)b;
+
+  return (x > y) - (x < y);
+
+}
+
+static void json_stats (const double *v, const int n) {
+
+  double *sorted = malloc(n * sizeof(double));
+  double sum = 0, sum_sq = 0;
+
+  for (int i=0; i < n; i++) {
+    sum += v[i];
+    sorted[i] = v[i];
+  }
+
+  const double mean = sum / n;
+
+  for (int i=0; i < n; i++)
+    sum_sq += (v[i] - mean) * (v[i] - mean);
+
+  qsort(sorted, n, sizeof(double), cmp_double);
+
+  const double median = (n & 1) ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+  const double sd = n > 1 ? sqrt(sum_sq / (n - 1)) : 0;
+  const double ci = bench_t95(n) * sd / sqrt(n);
+
+  printf("{\"mean\": %.2f, \"median\": %.2f, \"sd\": %.2f, \"ci95\": [%.2f, %.2f]}", mean, median, sd, mean - ci, mean + ci);
+
+  free(sorted);
+
+}
+
+static void json_run (const BenchRun *r, const int net, const int rep, const int last) {
+
+  char bm[6];
+
+  printf("    {\"net\": %d, \"rep\": %d, \"nodes\": %llu, \"us\": %llu, \"nps\": %llu, \"positions\": [",
+    net, rep,
+    (unsigned long long)r->total_nodes,
+    (unsigned long long)r->total_us,
+    (unsigned long long)bench_nps(r->total_nodes, r->total_us));
+
+  for (int i=0; i < BENCH_FENS; i++) {
+    format_move(r->best[i], bm);
+    printf("%s{\"nodes\": %llu, \"us\": %llu, \"nps\": %llu, \"bestmove\": \"%s\"}",
+      i ? ", " : "",
+      (unsigned long long)r->nodes[i],
+      (unsigned long long)r->us[i],
+      (unsigned long long)bench_nps(r->nodes[i], r->us[i]),
+      bm);
+  }
+
+  printf("]}%s\n", last ? "" : ",");
+
+}
+
+// repeat the bench reps times and print every run plus nps statistics as
+// json; given a second net the reps alternate abba between the net in use
+// and it, and the paired per rep nps difference is reported, which cancels
+// most of the drift in machine load that unpaired runs suffer
+
+void bench_json (int depth, int reps, const char *net_path) {
+
+  static BenchRun r;
+  char build[128], cpu[128];
+  int16_t *current = NULL;
+  int16_t *other = NULL;
+  double *nps = NULL;
+
+  if (reps < 1)
+    reps = 1;
+  if (reps > 1000)
+    reps = 1000;
+
+  // the net in use (maybe from LoadNet) is the baseline and is restored
+  if (net_path && (!(other = net_read_weights(net_path)) || !(current = net_copy_weights()))) {
+    free(other);
+    return;
+  }
+
+  nps = calloc(2 * reps, sizeof(double));
+  if (!nps) {
+    printf("error: bench out of memory\n");
+    free(current);
+    free(other);
+    return;
+  }
+
+  if (go_private_init(TT_DEFAULT_MB)) {
+    printf("error: cannot allocate %d MB for bench\n", TT_DEFAULT_MB);
+    free(nps);
+    free(current);
+    free(other);
+    return;
+  }
+
+  const int num_nets = other ? 2 : 1;
+
+  bench_features(build, cpu, sizeof(build));
+
+  printf("{\n");
+  printf("  \"version\": ");
+  json_string(BUILD);
+  printf(",\n  \"build_features\": ");
+  json_string(build);
+  printf(",\n  \"cpu_features\": ");
+  json_string(cpu);
+  printf(",\n  \"sliders\": ");
+  json_string(use_pext ? "pext" : "magic");
+  printf(",\n  \"depth\": %d,\n  \"threads\": %d,\n  \"hash\": %d,\n  \"reps\": %d,\n", depth, num_threads, TT_DEFAULT_MB, reps);
+  printf("  \"nets\": [");
+  json_string(net_current_name());
+  if (other) {
+    printf(", ");
+    json_string(net_path);
+  }
+  printf("],\n");
+  printf("  \"runs\": [\n");
+
+  for (int rep=0; rep < reps; rep++) {
+
+    for (int k=0; k < num_nets; k++) {
+
+      const int net = (rep & 1) ? num_nets - 1 - k : k;
+
+      if (other)
+        net_use_weights(net ? other : current);
+
+      bench_run(depth, num_threads, &r);
+      nps[net * reps + rep] = (double)bench_nps(r.total_nodes, r.total_us);
+
+      json_run(&r, net, rep, rep == reps - 1 && k == num_nets - 1);
+      fflush(stdout);
+
+    }
+
+  }
+
+  printf("  ],\n");
+  printf("  \"nps\": [");
+
+  for (int net=0; net < num_nets; net++) {
+    printf("%s", net ? ", " : "");
+    json_stats(&nps[net * reps], reps);
+  }
+
+  printf("]");
+
+  if (other) {
+
+    // percentage nps change of the second net over the one in use
+    for (int rep=0; rep < reps; rep++)
+      nps[rep] = 100.0 * (nps[reps + rep] / nps[rep] - 1.0);
+
+    printf(",\n  \"paired_pct\": ");
+    json_stats(nps, reps);
+
+    net_use_weights(current);
+
+  }
+
+  printf("\n}\n");
+
+  free(nps);
+  free(current);
+  free(other);
+  go_private_free();
+
+}
+
+#ifdef __linux__
+
+// one fresh copy of this binary given "uci" on its command line, timed from
+// fork to the uciok line arriving on its stdout; 0 if it failed to start
+static uint64_t startup_run (void) {
+
+  int fd[2];
+  char buf[4096];
+  uint64_t us = 0;
+
+  if (pipe(fd))
+    return 0;
+
+  const uint64_t start_us = time_us();
+  const pid_t pid = fork();
+
+  if (pid == 0) {
+    dup2(fd[1], STDOUT_FILENO);
+    close(fd[0]);
+    close(fd[1]);
+    execl("/proc/self/exe", "cwtch", "uci", (char *)NULL);
+    _exit(127);
+  }
+
+  close(fd[1]);
+
+  if (pid > 0) {
+
+    ssize_t got;
+    size_t keep = 0;
+
+    // uciok can be split across reads, so each read follows the last 4
+    // bytes of the one before
+    while (!us && (got = read(fd[0], buf + keep, sizeof(buf) - keep - 1)) > 0) {
+      const size_t len = keep + (size_t)got;
+      buf[len] = 0;
+      if (strstr(buf, "uciok"))
+        us = time_us() - start_us;
+      keep = len < 4 ? len : 4;
+      memmove(buf, buf + len - keep, keep);
+    }
+
+    waitpid(pid, NULL, 0);
+
+  }
+
+  close(fd[0]);
+
+  return us;
+
+}
+
+// process to uciok latency, the cost a match runner or datagen worker pays
+// every time it starts an engine
+void bench_startup (int runs) {
+
+  if (runs < 1)
+    runs = 20;
+
+  double *ms = calloc(runs, sizeof(double));
+  if (!ms) {
+    printf("error: startup out of memory\n");
+    return;
+  }
+
+  for (int i=0; i < runs; i++) {
+    const uint64_t us = startup_run();
+    if (!us) {
+      printf("error: cannot start /proc/self/exe\n");
+      free(ms);
+      return;
+    }
+    ms[i] = us / 1000.0;
+  }
+
+  qsort(ms, runs, sizeof(double), cmp_double);
+
+  double sum = 0;
+  for (int i=0; i < runs; i++)
+    sum += ms[i];
+
+  printf("startup runs %d mean %.2f ms median %.2f ms min %.2f ms max %.2f ms\n",
+    runs, sum / runs, ms[runs / 2], ms[0], ms[runs - 1]);
+
+  free(ms);
+
+}
+
+#else
+
+void bench_startup (int runs) {
+
+  (void)runs;
+  printf("startup: only timed on linux\n");
+
+}
+
+#endif
+
 void eval_tests (void) {
 
   const int num_fens = sizeof(bench_data) / sizeof(bench_data[0]);
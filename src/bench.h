@@ -1,7 +1,14 @@
 #ifndef BENCH_H
 #define BENCH_H
 
-void bench (int depth);
+#define BENCH_FENS 50
+
+void bench (int depth, int threads, int hash_mb);
+void bench_scale (int depth, int max_threads, int hash_mb);
+void bench_json (int depth, int reps, const char *net_path);
+void bench_profile (int depth, int threads);
+void bench_startup (int runs);
+void bench_position (const int i);
 void eval_tests (void);
 
 #endif
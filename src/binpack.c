@@ -0,0 +1,354 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "binpack.h"
+#include "types.h"
+#include "builtins.h"
+#include "nodes.h"
+#include "pos.h"
+#include "move.h"
+#include "makemove.h"
+#include "movegen.h"
+#include "mapfile.h"
+#include "viri.h"
+
+#define BP_SCORE_K    5     // exp-golomb order for score deltas
+#define BP_COUNT_K    6     // and for the move count
+#define BP_OUT_BYTES  (1 << 20)
+
+// --- bit stream ---
+
+typedef struct {
+  uint8_t *buf;
+  size_t bits;
+} BitWriter;
+
+typedef struct {
+  const uint8_t *buf;
+  size_t bits;
+  size_t limit;  // in bits
+} BitReader;
+
+static void put_bits(BitWriter *bw, uint32_t value, int n) {
+
+  while (n--) {
+    const size_t byte = bw->bits >> 3;
+    if (!(bw->bits & 7))
+      bw->buf[byte] = 0;
+    bw->buf[byte] |= ((value >> n) & 1) << (7 - (bw->bits & 7));
+    bw->bits++;
+  }
+
+}
+
+// 1 if the stream ran out
+static int get_bits(BitReader *br, int n, uint32_t *value) {
+
+  if (br->bits + n > br->limit)
+    return 1;
+
+  uint32_t v = 0;
+
+  while (n--) {
+    v = (v << 1) | ((br->buf[br->bits >> 3] >> (7 - (br->bits & 7))) & 1);
+    br->bits++;
+  }
+
+  *value = v;
+
+  return 0;
+
+}
+
+// exp-golomb of order k; small values take few bits
+static void put_golomb(BitWriter *bw, const uint32_t value, const int k) {
+
+  const uint64_t x = (uint64_t)value + (1ULL << k);
+  const int n = 64 - __builtin_clzll(x);
+
+  put_bits(bw, 0, n - 1 - k);
+  if (n > 32) {
+    put_bits(bw, (uint32_t)(x >> 32), n - 32);
+    put_bits(bw, (uint32_t)x, 32);
+  }
+  else
+    put_bits(bw, (uint32_t)x, n);
+
+}
+
+static int get_golomb(BitReader *br, const int k, uint32_t *value) {
+
+  int zeros = 0;
+  uint32_t bit = 0;
+
+  while (!get_bits(br, 1, &bit) && !bit) {
+    if (++zeros > 32)
+      return 1;
+  }
+
+  if (!bit)
+    return 1;
+
+  uint32_t rest = 0;
+  if (zeros + k && get_bits(br, zeros + k, &rest))
+    return 1;
+
+  const uint64_t x = (1ULL << (zeros + k)) | rest;
+  *value = (uint32_t)(x - (1ULL << k));
+
+  return 0;
+
+}
+
+static uint32_t zigzag(const int v) {
+  return v < 0 ? ((uint32_t)(-(int64_t)v) << 1) - 1 : (uint32_t)v << 1;
+}
+
+static int unzigzag(const uint32_t v) {
+  return v & 1 ? -(int)((v + 1) >> 1) : (int)(v >> 1);
+}
+
+// --- moves ---
+
+static int cmp_keys(const void *a, const void *b) {
+  const uint32_t x = *(const uint32_t *)a;
+  const uint32_t y = *(const uint32_t *)b;
+  return (x > y) - (x < y);
+}
+
+// legal moves in viriformat, sorted so the order does not depend on the
+// move generator; moves[i] is the engine move for out[i]
+static int sorted_legal(const Position *pos, uint16_t *out, move_t *moves) {
+
+  move_t legal[MAX_MOVES];
+  uint32_t keys[MAX_MOVES];
+  const int n = gen_legal_moves(pos, legal);
+
+  for (int i = 0; i < n; i++)
+    keys[i] = ((uint32_t)move_to_viri(legal[i]) << 8) | i;
+
+  qsort(keys, n, sizeof(uint32_t), cmp_keys);
+
+  for (int i = 0; i < n; i++) {
+    out[i] = (uint16_t)(keys[i] >> 8);
+    moves[i] = legal[keys[i] & 0xFF];
+  }
+
+  return n;
+
+}
+
+static int index_bits(const int n) {
+  return n > 1 ? 32 - __builtin_clz((uint32_t)(n - 1)) : 0;
+}
+
+// --- games ---
+
+// pack the viriformat game in rec; returns the bytes written to out or 0
+// if the game does not replay
+size_t binpack_game(const uint8_t *rec, const size_t len, uint8_t *out) {
+
+  const int num_moves = (int)((len - VIRI_BOARD_BYTES) / VIRI_MOVE_BYTES) - 1;
+  BitWriter bw = {out + VIRI_BOARD_BYTES, 0};
+  uint16_t sorted[MAX_MOVES];
+  move_t moves[MAX_MOVES];
+  Position pos;
+  int16_t prev;
+
+  if (num_moves < 0 || packed_board_to_pos(rec, &pos))
+    return 0;
+
+  memcpy(out, rec, VIRI_BOARD_BYTES);
+  memcpy(&prev, rec + 28, 2);
+
+  put_golomb(&bw, num_moves, BP_COUNT_K);
+
+  for (int i = 0; i < num_moves; i++) {
+
+    ViriMove vm;
+    memcpy(&vm, rec + VIRI_BOARD_BYTES + i * VIRI_MOVE_BYTES, VIRI_MOVE_BYTES);
+
+    const int n = sorted_legal(&pos, sorted, moves);
+    int idx = 0;
+    while (idx < n && sorted[idx] != vm.move)
+      idx++;
+
+    if (idx == n)
+      return 0;
+
+    put_bits(&bw, idx, index_bits(n));
+    put_golomb(&bw, zigzag(vm.score - prev), BP_SCORE_K);
+
+    prev = vm.score;
+    make_move_pos(&pos, moves[idx]);
+
+  }
+
+  return VIRI_BOARD_BYTES + (bw.bits + 7) / 8;
+
+}
+
+// unpack one game from in into a viriformat record; returns the record's
+// length and sets consumed, or returns 0 if the data is truncated or bad
+size_t unbinpack_game(const uint8_t *in, const size_t avail, uint8_t *rec, const size_t rec_size, size_t *consumed) {
+
+  uint16_t sorted[MAX_MOVES];
+  move_t moves[MAX_MOVES];
+  Position pos;
+  uint32_t num_moves;
+  int16_t prev;
+
+  if (avail < VIRI_BOARD_BYTES || packed_board_to_pos(in, &pos))
+    return 0;
+
+  BitReader br = {in + VIRI_BOARD_BYTES, 0, (avail - VIRI_BOARD_BYTES) * 8};
+
+  if (get_golomb(&br, BP_COUNT_K, &num_moves))
+    return 0;
+
+  const size_t len = VIRI_BOARD_BYTES + ((size_t)num_moves + 1) * VIRI_MOVE_BYTES;
+  if (len > rec_size)
+    return 0;
+
+  memcpy(rec, in, VIRI_BOARD_BYTES);
+  memcpy(&prev, in + 28, 2);
+
+  for (uint32_t i = 0; i < num_moves; i++) {
+
+    uint32_t idx = 0;
+    uint32_t delta;
+    const int n = sorted_legal(&pos, sorted, moves);
+
+    if (get_bits(&br, index_bits(n), &idx) || (int)idx >= n)
+      return 0;
+    if (get_golomb(&br, BP_SCORE_K, &delta))
+      return 0;
+
+    ViriMove vm = {sorted[idx], (int16_t)(prev + unzigzag(delta))};
+    memcpy(rec + VIRI_BOARD_BYTES + i * VIRI_MOVE_BYTES, &vm, VIRI_MOVE_BYTES);
+
+    prev = vm.score;
+    make_move_pos(&pos, moves[idx]);
+
+  }
+
+  memset(rec + len - VIRI_MOVE_BYTES, 0, VIRI_MOVE_BYTES);
+  *consumed = VIRI_BOARD_BYTES + (br.bits + 7) / 8;
+
+  return len;
+
+}
+
+// --- files ---
+
+static int bp_open(const char *in_path, const char *out_path, MappedFile *in, FILE **out) {
+
+  if (map_file(in, in_path)) {
+    printf("error: cannot read %s\n", in_path);
+    return 1;
+  }
+
+  *out = fopen(out_path, "wb");
+  if (!*out) {
+    printf("error: cannot open %s\n", out_path);
+    unmap_file(in);
+    return 1;
+  }
+
+  setvbuf(*out, NULL, _IOFBF, BP_OUT_BYTES);
+
+  return 0;
+
+}
+
+static void bp_close(MappedFile *in, FILE *out, const char *what, const uint64_t games, const uint64_t bytes_out) {
+
+  fclose(out);
+
+  printf("%s: %llu games, %llu -> %llu bytes (%.2fx)\n", what,
+    (unsigned long long)games,
+    (unsigned long long)in->size,
+    (unsigned long long)bytes_out,
+    bytes_out ? (double)in->size / bytes_out : 0.0);
+
+  unmap_file(in);
+
+}
+
+void binpack_file(const char *in_path, const char *out_path) {
+
+  MappedFile in;
+  FILE *out;
+  uint8_t *buf = malloc(BINPACK_MAX_BYTES(65536));
+  uint64_t games = 0;
+  uint64_t bytes_out = 0;
+  size_t offset = 0;
+
+  if (!buf || bp_open(in_path, out_path, &in, &out)) {
+    free(buf);
+    return;
+  }
+
+  while (offset < in.size) {
+
+    const size_t end = viri_record_end(in.data, in.size, offset);
+    if (!end) {
+      printf("error: truncated record at offset %llu\n", (unsigned long long)offset);
+      break;
+    }
+
+    const size_t n = end - offset <= BINPACK_MAX_BYTES(65536) ? binpack_game(in.data + offset, end - offset, buf) : 0;
+    if (!n)
+      printf("error: skipping game at offset %llu, it does not replay\n", (unsigned long long)offset);
+    else {
+      fwrite(buf, 1, n, out);
+      bytes_out += n;
+      games++;
+    }
+
+    offset = end;
+
+  }
+
+  free(buf);
+  bp_close(&in, out, "vfpack", games, bytes_out);
+
+}
+
+void unbinpack_file(const char *in_path, const char *out_path) {
+
+  MappedFile in;
+  FILE *out;
+  const size_t rec_size = VIRI_BOARD_BYTES + (65536 + 1) * VIRI_MOVE_BYTES;
+  uint8_t *rec = malloc(rec_size);
+  uint64_t games = 0;
+  uint64_t bytes_out = 0;
+  size_t offset = 0;
+
+  if (!rec || bp_open(in_path, out_path, &in, &out)) {
+    free(rec);
+    return;
+  }
+
+  while (offset < in.size) {
+
+    size_t consumed = 0;
+    const size_t len = unbinpack_game(in.data + offset, in.size - offset, rec, rec_size, &consumed);
+
+    if (!len) {
+      printf("error: bad or truncated game at offset %llu\n", (unsigned long long)offset);
+      break;
+    }
+
+    fwrite(rec, 1, len, out);
+    bytes_out += len;
+    games++;
+    offset += consumed;
+
+  }
+
+  free(rec);
+  bp_close(&in, out, "vfunpack", games, bytes_out);
+
+}
@@ -0,0 +1,22 @@
+#ifndef BINPACK_H
+#define BINPACK_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// a compact form of viriformat: each game keeps its 32 byte PackedBoard,
+// followed by a bit stream of the move count and, per position, the move's
+// index in the sorted legal move list and the change in score since the
+// previous position; games are byte aligned
+
+#define BINPACK_EXT ".cbp"
+
+// worst case bytes for a game of n moves
+#define BINPACK_MAX_BYTES(n) (32 + 8 + (n) * 8)
+
+size_t binpack_game(const uint8_t *rec, const size_t len, uint8_t *out);
+size_t unbinpack_game(const uint8_t *in, const size_t avail, uint8_t *rec, const size_t rec_size, size_t *consumed);
+void binpack_file(const char *in_path, const char *out_path);
+void unbinpack_file(const char *in_path, const char *out_path);
+
+#endif
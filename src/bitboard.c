@@ -3,11 +3,18 @@
 #include "types.h"
 #include "builtins.h"
 #include "bitboard.h"
-#include "zobrist.h"
 
-#define MAGIC_MAX_SLOTS 4096
+#if defined(__x86_64__) || defined(__i386__)
+  #include <cpuid.h>
+  #include <immintrin.h>
+  #define HAVE_PEXT 1
+#else
+  #define HAVE_PEXT 0
+#endif
 
-static uint64_t raw_attacks[107648];
+#define SLIDER_SLOTS 107648
+
+static uint64_t raw_attacks[SLIDER_SLOTS];
 uint64_t pawn_attacks[2][64];
 uint64_t knight_attacks[64];
 Attack bishop_attacks[64];
@@ -15,113 +22,50 @@ Attack rook_attacks[64];
 uint64_t king_attacks[64];
 uint64_t all_attacks[64];
 uint64_t all_attacks_inc_edge[64];
-
-static void get_blockers(Attack *a, uint64_t *blockers) {
-
-  int bits[64];
-  int num_bits = 0;
-
-  for (int b=0; b < 64; b++) {
-    if (a->mask & (1ULL << b)) {
-      bits[num_bits++] = b;
-    }
-  }
-
-  for (int i=0; i < a->count; i++) {
-
-    uint64_t blocker = 0;
-
-    for (int j=0; j < a->bits; j++) {
-      if (i & (1 << j)) {
-        blocker |= 1ULL << bits[j];
-      }
-    }
-
-    blockers[i] = blocker;
-
-  }
-}
-
-static void find_magics(Attack attacks[64], const char *label) {
-
-  uint64_t tbl[MAGIC_MAX_SLOTS];
-  uint32_t used[MAGIC_MAX_SLOTS];
-
-  static uint32_t stamp = 1;
-  const int verbose = 0;
-  int total_tries = 0;
-  int total_slots = 0;
-
-  for (int sq=0; sq < 64; ++sq) {
-
-    Attack *a = &attacks[sq];
-    const int N = a->count;
-
-    uint64_t blockers[MAGIC_MAX_SLOTS];
-    get_blockers(a, blockers);
-
-    memset(used, 0, (size_t)N * sizeof used[0]);
-
-    int tries = 0;
-
-    for (;;) {
-
-      ++tries;
-
-      if (++stamp == 0) {
-        memset(used, 0, (size_t)N * sizeof used[0]);
-        stamp = 1;
-      }
-
-      const uint64_t magic = rand64() & rand64() & rand64();
-
-      if (popcount((a->mask * magic) >> (64 - a->bits)) < a->bits - 3) // 3 tuned
-        continue;
-
-      int fail = 0;
-
-      for (int i=0; i < N; ++i) {
-
-        const int idx = magic_index(blockers[i], magic, a->shift);
-        const uint64_t att = a->attacks[i];
-
-        if (used[idx] != stamp) {
-          used[idx] = stamp;
-          tbl[idx] = att;
-        }
-        else if (tbl[idx] != att) {
-          fail = 1;
-          break;
-        }
-      }
-
-      if (!fail) {
-
-        a->magic = magic;
-
-        for (int i=0; i < N; ++i) {
-          const int idx = magic_index(blockers[i], magic, a->shift);
-          a->attacks[idx] = tbl[idx];
-        }
-
-        if (verbose) {
-          printf("%s sq %2d tries %d %8d magic %llx\n",
-                 label, sq, tries, N, (unsigned long long)a->magic);
-        }
-
-        total_tries += tries;
-        total_slots += N;
-
-        break;
-
-      }
-    }
-  }
-
-  if (verbose)
-    printf("%s total_tries %d total_slots %d\n", label, total_tries, total_slots);
-
-}
+uint64_t between_bb[64][64];
+uint64_t line_bb[64][64];
+SliderAttacks slider_attacks;
+int use_pext = 0;
+
+// magics for the fixed shift 64 - bits, found once by a trial search over
+// sparse xorshift numbers; with these the tables fill in one pass at startup
+static const uint64_t bishop_magics[64] = {
+  0x0018911026004900ULL, 0x0020080106408600ULL, 0x0024282600400220ULL, 0x0c04104208021041ULL,
+  0x1008484040000003ULL, 0x000202100420c800ULL, 0x8200808820500301ULL, 0x08108c00880c0200ULL,
+  0x4000102608013c10ULL, 0x0430188108088904ULL, 0x0010900082014100ULL, 0x0006140400800200ULL,
+  0x40001310c0000c29ULL, 0x0000020524200211ULL, 0x442840840c200cc0ULL, 0x008164c20084e000ULL,
+  0x0040001111191900ULL, 0x008802102246c400ULL, 0x0102000402220a00ULL, 0x000800c38200c180ULL,
+  0x0004024610220000ULL, 0x0c28a08202102204ULL, 0x010c410082101080ULL, 0x0002400021080829ULL,
+  0x0008080005212808ULL, 0x0a722800a0052400ULL, 0x0002020091040400ULL, 0x2001004004040002ULL,
+  0x0c81010100104000ULL, 0x8001120009008088ULL, 0x608b0049441e0804ULL, 0x0844008040404c00ULL,
+  0x001006f040200400ULL, 0x808802a840020814ULL, 0x1005402800100040ULL, 0x4060420080480080ULL,
+  0x0e020084001a0020ULL, 0x0002004200110080ULL, 0x080828810401a800ULL, 0x80320069000a0280ULL,
+  0x49041c20040e4840ULL, 0x0005241004142220ULL, 0x0000b400a8020400ULL, 0x0000004010420202ULL,
+  0x0008080208220400ULL, 0x4040880104080040ULL, 0x000809012a040420ULL, 0x0222145440806201ULL,
+  0x1002008208400004ULL, 0xa004210412200002ULL, 0x280084cc040c2010ULL, 0x1008840084040010ULL,
+  0x0000202020864040ULL, 0x0002202401820002ULL, 0x2008201484025204ULL, 0x00200b3901010000ULL,
+  0x8000840400844408ULL, 0x0f004d0402069200ULL, 0x1404800300809000ULL, 0x4804000102050400ULL,
+  0x0088000020020480ULL, 0xd800031060411100ULL, 0x008148480808dc00ULL, 0x0042200220a60081ULL
+};
+
+static const uint64_t rook_magics[64] = {
+  0x0180002040001083ULL, 0x0940004020041009ULL, 0x1300104102082000ULL, 0x210004e010010028ULL,
+  0x0080080002800400ULL, 0x20800c0080012a00ULL, 0x8c00008410020801ULL, 0x0300020040842100ULL,
+  0x0500802040008001ULL, 0x1101004000802100ULL, 0x0042002042059280ULL, 0x0429808030002800ULL,
+  0x00e0800400080280ULL, 0x0090806200804400ULL, 0x0104000421820810ULL, 0x0012000200408134ULL,
+  0x1884248000844000ULL, 0x0040008040802000ULL, 0x0820110040200500ULL, 0x0420808008001000ULL,
+  0x0000050008010010ULL, 0xc002008004008002ULL, 0x8805440041183012ULL, 0x0c0002000081104cULL,
+  0x0240400c80208000ULL, 0x0320100440024020ULL, 0x8080200080801000ULL, 0x0000100080080080ULL,
+  0x0a02000600205048ULL, 0x000a010200104408ULL, 0x3000080400213002ULL, 0x4428340200008843ULL,
+  0x018140013180008cULL, 0x2120442000401000ULL, 0x4180802008801000ULL, 0xa080081001002100ULL,
+  0x0004040080800800ULL, 0x0204040080800200ULL, 0x01a0081504000670ULL, 0x00040040a2000401ULL,
+  0x8880804000248000ULL, 0x0100400020008080ULL, 0x0030040028002001ULL, 0x000c10412202000aULL,
+  0x0408000400088080ULL, 0x3102008004008002ULL, 0x4020c80190040002ULL, 0x0001040060820001ULL,
+  0x000100204a008600ULL, 0x0100200040008080ULL, 0x2100804016002600ULL, 0x4030004400080040ULL,
+  0x0107001108004500ULL, 0x000c817a00040080ULL, 0x2021008200040100ULL, 0x00402300840e4200ULL,
+  0x2420208203004016ULL, 0x0504a09082044102ULL, 0x8410200041001209ULL, 0x1002004004200812ULL,
+  0x008200201008ac5aULL, 0xc202000410080102ULL, 0x0000300801020094ULL, 0x0000022504008842ULL
+};
 
 static void init_pawn_attacks(void) {
 
@@ -156,11 +100,25 @@ static void init_knight_attacks(void) {
   }
 }
 
-static void init_bishop_attacks(void) {
+static uint64_t magic_attacks(const Attack *a, const uint64_t occ) {
+  return a->attacks[magic_index(occ & a->mask, a->magic, a->shift)];
+}
+
+#if HAVE_PEXT
+__attribute__((target("bmi2"))) static uint64_t pext_attacks(const Attack *a, const uint64_t occ) {
+  return a->attacks[_pext_u64(occ, a->mask)];
+}
+#endif
 
-  int next_attack_index = 0;
+// the carry rippler visits the subsets of a mask in pext order, so the
+// n-th subset's pext index is n and the tables fill without bmi2
+static int table_index(const Attack *a, const uint64_t blockers, const int n) {
+  return use_pext ? n : magic_index(blockers, a->magic, a->shift);
+}
+
+static void init_bishop_attacks(void) {
 
-  uint64_t blockers[MAGIC_MAX_SLOTS];
+  int next_slot = 0;
 
   for (int sq=0; sq < 64; sq++) {
 
@@ -183,16 +141,16 @@ static void init_bishop_attacks(void) {
     for (int r = rank - 1, f = file - 1; r >= 1 && f >= 1; r--, f--)
       a->mask |= 1ULL << (r * 8 + f);
     
-    a->bits = popcount(a->mask);
-    a->shift = 64 - a->bits;
-    a->count = 1 << a->bits;
-    a->attacks = &raw_attacks[next_attack_index];
+    a->shift = 64 - popcount(a->mask);
+    a->magic = bishop_magics[sq];
+    a->attacks = &raw_attacks[next_slot];
 
-    get_blockers(a, blockers);
+    // every subset of the mask, carry rippler order
+    uint64_t blocker = 0;
+    int n = 0;
 
-    for (int i=0; i < a->count; i++) {
+    do {
       
-      uint64_t blocker = blockers[i];
       uint64_t attack = 0;
       
       for (int r=rank+1, f=file+1; r <= 7 && f <= 7; r++, f++) {
@@ -223,20 +181,19 @@ static void init_bishop_attacks(void) {
           break;
       }
       
-      raw_attacks[next_attack_index++] = attack;
+      raw_attacks[next_slot + table_index(a, blocker, n++)] = attack;
+      blocker = (blocker - a->mask) & a->mask;
       
-    }
-  }
+    } while (blocker);
 
-  find_magics(bishop_attacks, "B");
+    next_slot += 1 << (64 - a->shift);
 
+  }
 }
 
 static void init_rook_attacks(void) {
 
-  int next_attack_index = 5248;
-
-  uint64_t blockers[MAGIC_MAX_SLOTS];
+  int next_slot = 5248;
 
   for (int sq=0; sq < 64; sq++) {
 
@@ -259,16 +216,16 @@ static void init_rook_attacks(void) {
     for (int r=rank-1; r >= 1; r--)
       a->mask |= 1ULL << (r * 8 + file);
     
-    a->bits = popcount(a->mask);
-    a->shift = 64 - a->bits;
-    a->count = 1 << a->bits;
-    a->attacks = &raw_attacks[next_attack_index];
+    a->shift = 64 - popcount(a->mask);
+    a->magic = rook_magics[sq];
+    a->attacks = &raw_attacks[next_slot];
 
-    get_blockers(a, blockers);
+    // every subset of the mask, carry rippler order
+    uint64_t blocker = 0;
+    int n = 0;
 
-    for (int i=0; i < a->count; i++) {
+    do {
       
-      uint64_t blocker = blockers[i];
       uint64_t attack = 0;
       
       for (int r=rank+1; r <= 7; r++) {
@@ -303,13 +260,14 @@ static void init_rook_attacks(void) {
         }
       }
       
-      raw_attacks[next_attack_index++] = attack;
+      raw_attacks[next_slot + table_index(a, blocker, n++)] = attack;
+      blocker = (blocker - a->mask) & a->mask;
       
-    }
-  }
+    } while (blocker);
 
-  find_magics(rook_attacks, "R");
+    next_slot += 1 << (64 - a->shift);
 
+  }
 }
 
 static void init_king_attacks(void) {
@@ -375,13 +333,92 @@ static void init_all_attacks(void) {
   }
 }
 
+static void init_lines(void) {
+
+  // opposite directions are 4 apart
+  const int dr[8] = {1, 1, 0, -1, -1, -1,  0,  1};
+  const int df[8] = {0, 1, 1,  1,  0, -1, -1, -1};
+  uint64_t rays[8][64];
+
+  for (int sq=0; sq < 64; sq++) {
+    for (int dir=0; dir < 8; dir++) {
+      uint64_t bb = 0;
+      for (int r = sq / 8 + dr[dir], f = sq % 8 + df[dir]; r >= 0 && r < 8 && f >= 0 && f < 8; r += dr[dir], f += df[dir])
+        bb |= 1ULL << (r * 8 + f);
+      rays[dir][sq] = bb;
+    }
+  }
+
+  memset(between_bb, 0, sizeof(between_bb));
+  memset(line_bb, 0, sizeof(line_bb));
+
+  for (int sq=0; sq < 64; sq++) {
+    for (int dir=0; dir < 8; dir++) {
+
+      const uint64_t line = rays[dir][sq] | rays[(dir + 4) & 7][sq] | (1ULL << sq);
+      uint64_t between = 0;
+      uint64_t ray = rays[dir][sq];
+      const int up = dr[dir] * 8 + df[dir] > 0;
+
+      // walk outwards from sq
+      while (ray) {
+        const int to = up ? bsf(ray) : msb(ray);
+        ray ^= 1ULL << to;
+        between_bb[sq][to] = between;
+        line_bb[sq][to] = line;
+        between |= 1ULL << to;
+      }
+
+    }
+  }
+}
+
+// pext needs bmi2, and before zen 3 amd runs it as microcode at hundreds
+// of cycles, far slower than a magic multiply
+static int fast_pext(void) {
+
+#if HAVE_PEXT
+
+  __builtin_cpu_init();
+  if (!__builtin_cpu_supports("bmi2"))
+    return 0;
+
+  unsigned a, b, c, d;
+
+  if (!__get_cpuid(0, &a, &b, &c, &d))
+    return 0;
+  const int amd = b == signature_AMD_ebx;
+
+  __get_cpuid(1, &a, &b, &c, &d);
+  int family = (a >> 8) & 0xF;
+  if (family == 0xF)
+    family += (a >> 20) & 0xFF;
+
+  return !(amd && family < 0x19);
+
+#else
+
+  return 0;
+
+#endif
+
+}
+
 void init_attacks(void) {
 
+  use_pext = fast_pext();
+#if HAVE_PEXT
+  slider_attacks = use_pext ? pext_attacks : magic_attacks;
+#else
+  slider_attacks = magic_attacks;
+#endif
+
   init_pawn_attacks();
   init_knight_attacks();
   init_bishop_attacks();
   init_rook_attacks();
   init_king_attacks();
   init_all_attacks();
+  init_lines();
 
 }
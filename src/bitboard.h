@@ -3,17 +3,20 @@
 
 #include <stdint.h>
 
+// one aligned half cache line per square
 typedef struct {
 
-  int bits;
-  int count;
-  int shift;
-  uint64_t mask;
+  _Alignas(32) uint64_t mask;
   uint64_t magic;
-  uint64_t *attacks;
+  const uint64_t *attacks;  // indexed by the backend's pext or magic index
+  int shift;
 
 } Attack;
 
+// the lookup backend, pext or a magic multiply, picked once by init_attacks
+// so no lookup tests which one is in use
+typedef uint64_t (*SliderAttacks)(const Attack *a, const uint64_t occ);
+
 extern uint64_t pawn_attacks[2][64];
 extern uint64_t knight_attacks[64];
 extern Attack bishop_attacks[64];
@@ -21,11 +24,23 @@ extern Attack rook_attacks[64];
 extern uint64_t king_attacks[64];
 extern uint64_t all_attacks[64];
 extern uint64_t all_attacks_inc_edge[64];
+extern uint64_t between_bb[64][64];  // squares strictly between two aligned squares
+extern uint64_t line_bb[64][64];     // the whole line through two aligned squares
+extern SliderAttacks slider_attacks;
+extern int use_pext;
 
 inline int magic_index(const uint64_t blockers, const uint64_t magic, const int shift) {
   return (int)((blockers * magic) >> shift);
 }
 
+inline uint64_t bishop_attacks_bb(const int sq, const uint64_t occ) {
+  return slider_attacks(&bishop_attacks[sq], occ);
+}
+
+inline uint64_t rook_attacks_bb(const int sq, const uint64_t occ) {
+  return slider_attacks(&rook_attacks[sq], occ);
+}
+
 void init_attacks(void);
 
 #endif
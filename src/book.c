@@ -0,0 +1,83 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "book.h"
+#include "mapfile.h"
+
+int book_open(Book *book, const char *path) {
+
+  memset(book, 0, sizeof(Book));
+
+  if (map_file(&book->file, path)) {
+    printf("error: cannot read book %s\n", path);
+    return 1;
+  }
+
+  // index the line starts so workers can shard by line number
+  uint64_t cap = 1024;
+  book->lines = malloc(cap * sizeof(uint64_t));
+
+  const char *data = (const char *)book->file.data;
+  const size_t size = book->file.size;
+
+  for (size_t i=0; i < size && book->lines; ) {
+
+    const char *nl = memchr(data + i, '\n', size - i);
+    const size_t end = nl ? (size_t)(nl - data) : size;
+
+    if (end > i && data[i] != '#' && data[i] != '\r') {
+      if (book->num_lines == cap) {
+        cap *= 2;
+        uint64_t *grown = realloc(book->lines, cap * sizeof(uint64_t));
+        if (!grown) {
+          free(book->lines);
+          book->lines = NULL;
+          break;
+        }
+        book->lines = grown;
+      }
+      book->lines[book->num_lines++] = i;
+    }
+
+    i = end + 1;
+
+  }
+
+  if (!book->lines || !book->num_lines) {
+    printf("error: no positions in book %s\n", path);
+    book_close(book);
+    return 1;
+  }
+
+  return 0;
+
+}
+
+void book_close(Book *book) {
+
+  unmap_file(&book->file);
+  free(book->lines);
+  memset(book, 0, sizeof(Book));
+
+}
+
+// copy line index (mod the line count) into buf, return its length
+int book_line(const Book *book, const uint64_t index, char *buf, const size_t size) {
+
+  const char *data = (const char *)book->file.data;
+  const uint64_t start = book->lines[index % book->num_lines];
+  size_t len = 0;
+
+  while (start + len < book->file.size && len + 1 < size) {
+    const char c = data[start + len];
+    if (c == '\n' || c == '\r')
+      break;
+    buf[len++] = c;
+  }
+
+  buf[len] = '\0';
+
+  return (int)len;
+
+}
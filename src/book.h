@@ -0,0 +1,19 @@
+#ifndef BOOK_H
+#define BOOK_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "mapfile.h"
+
+// read-only epd opening book, mapped once and shared by all threads
+typedef struct {
+  MappedFile file;
+  uint64_t *lines;  // offset of each non-empty line
+  uint64_t num_lines;
+} Book;
+
+int book_open(Book *book, const char *path);
+void book_close(Book *book);
+int book_line(const Book *book, const uint64_t index, char *buf, const size_t size);
+
+#endif
@@ -3,7 +3,8 @@
 #include "pos.h"
 #include "corrhist.h"
 
-int16_t pawn_corr[2][CORR_SIZE];
+static CorrHist corr_shared;
+_Thread_local CorrHist *thread_corr = &corr_shared;
 
 // splitmix64 finaliser
 static inline uint64_t mix64(uint64_t x) {
@@ -22,7 +23,7 @@ static inline int16_t *pawn_entry(const Position *pos) {
 
   const uint64_t key = mix64(pos->all[WPAWN] ^ mix64(pos->all[BPAWN]));
 
-  return &pawn_corr[pos->stm][key & (CORR_SIZE - 1)];
+  return &thread_corr->pawn_corr[pos->stm][key & (CORR_SIZE - 1)];
 
 }
 
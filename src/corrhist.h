@@ -12,10 +12,14 @@
 #define CORR_WEIGHT_MAX 16
 #define CORR_WEIGHT_SCALE 256
 
-extern int16_t pawn_corr[2][CORR_SIZE];
+typedef struct {
+  int16_t pawn_corr[2][CORR_SIZE];
+} CorrHist;
+
+extern _Thread_local CorrHist *thread_corr;  // shared by smp threads unless the thread owns one
 
 inline void clear_corrhist(void) {
-  memset(pawn_corr, 0, sizeof(pawn_corr));
+  memset(thread_corr->pawn_corr, 0, sizeof(thread_corr->pawn_corr));
 }
 
 int correct_eval(const Position *pos, const int ev);
@@ -2,6 +2,14 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#ifdef _WIN32
+  #include <io.h>
+#else
+  #include <unistd.h>
+#endif
 #include "datagen.h"
 #include "types.h"
 #include "builtins.h"
@@ -13,38 +21,172 @@
 #include "hh.h"
 #include "timecontrol.h"
 #include "go.h"
+#include "search.h"
+#include "qsearch.h"
 #include "position.h"
-#include "iterate.h"
+#include "movegen.h"
 #include "net.h"
 #include "uci.h"
+#include "writer.h"
+#include "book.h"
+#include "viri.h"
+#include "binpack.h"
 
+// defaults; each can be overridden per run with name=value, see dg_options
 #define DG_RANDOM_PLIES   10
 #define DG_SEARCH_NODES   5000
 #define DG_DRAW_SCORE     10
 #define DG_DRAW_COUNT     10
 #define DG_DRAW_PLY       40
-#define DG_MAX_GAME_MOVES 512
+#define DG_WIN_SCORE      1500
+#define DG_WIN_COUNT      3
+#define DG_OPEN_EVAL      0    // max |static eval| after the opening, 0 = any
+#define DG_HASH_MB        16   // private tt per worker
+#define DG_FSYNC_SECS     60   // 0 = never fsync
+#define DG_CHECKPOINT_SECS 60  // manifest update interval
+#define DG_SIDECAR        0    // write a DatagenSide per position
+#define DG_BINPACK        0    // write .cbp shards instead of .vf
+
+#define DG_MAX_GAME_MOVES 512  // upper bound for max_moves
 #define DG_REPORT_SECS    10
+#define DG_MAX_FAILS      10000  // attempts in a row without a game before a worker gives up
 #define DG_FILE_PREFIX    "data"
+#define DG_MAX_THREADS    256
+#define DG_RECORD_BYTES   (32 + DG_MAX_GAME_MOVES * 4 + 4)
+#define DG_MANIFEST       "datagen.manifest"
+#define DG_MANIFEST_MAGIC "cwtch-datagen"
+#define DG_MANIFEST_VERSION 1
 
-// --- viriformat constants ---
+typedef struct {
+  int random_plies;
+  int nodes;
+  int draw_score;
+  int draw_count;
+  int draw_ply;
+  int win_score;
+  int win_count;
+  int max_moves;
+  int open_eval;
+  int hash_mb;
+  int fsync_secs;
+  int checkpoint_secs;
+  int sidecar;
+  int binpack;
+} DatagenConfig;
+
+typedef struct {
+  const char *name;
+  size_t offset;
+  int min;
+  int max;
+} DatagenOption;
+
+static const DatagenOption dg_options[] = {
+  {"random_plies", offsetof(DatagenConfig, random_plies), 0,   64},
+  {"nodes",        offsetof(DatagenConfig, nodes),        1,   100000000},
+  {"draw_score",   offsetof(DatagenConfig, draw_score),   0,   MATEISH},
+  {"draw_count",   offsetof(DatagenConfig, draw_count),   1,   DG_MAX_GAME_MOVES},
+  {"draw_ply",     offsetof(DatagenConfig, draw_ply),     0,   DG_MAX_GAME_MOVES},
+  {"win_score",    offsetof(DatagenConfig, win_score),    1,   MATE},
+  {"win_count",    offsetof(DatagenConfig, win_count),    1,   DG_MAX_GAME_MOVES},
+  {"max_moves",    offsetof(DatagenConfig, max_moves),    1,   DG_MAX_GAME_MOVES},
+  {"open_eval",    offsetof(DatagenConfig, open_eval),    0,   MATE},
+  {"hash",         offsetof(DatagenConfig, hash_mb),      1,   1024},
+  {"fsync",        offsetof(DatagenConfig, fsync_secs),   0,   86400},
+  {"checkpoint",   offsetof(DatagenConfig, checkpoint_secs), 1, 86400},
+  {"sidecar",      offsetof(DatagenConfig, sidecar),      0,   1},
+  {"binpack",      offsetof(DatagenConfig, binpack),      0,   1},
+};
+
+#define DG_NUM_OPTIONS (sizeof(dg_options) / sizeof(dg_options[0]))
+
+static DatagenConfig dg_cfg;
+static Book dg_book;
+static const char *dg_book_path;
+static char dg_book_buf[512];
+static uint64_t dg_run_seed;
+static int dg_seed_given;
+
+static void dg_default_config(void) {
+  dg_cfg = (DatagenConfig){
+    .random_plies = DG_RANDOM_PLIES,
+    .nodes        = DG_SEARCH_NODES,
+    .draw_score   = DG_DRAW_SCORE,
+    .draw_count   = DG_DRAW_COUNT,
+    .draw_ply     = DG_DRAW_PLY,
+    .win_score    = DG_WIN_SCORE,
+    .win_count    = DG_WIN_COUNT,
+    .max_moves    = DG_MAX_GAME_MOVES,
+    .open_eval    = DG_OPEN_EVAL,
+    .hash_mb      = DG_HASH_MB,
+    .fsync_secs   = DG_FSYNC_SECS,
+    .checkpoint_secs = DG_CHECKPOINT_SECS,
+    .sidecar      = DG_SIDECAR,
+    .binpack      = DG_BINPACK,
+  };
+  dg_book_path = NULL;
+  dg_seed_given = 0;
+}
+
+// name=value, returns 1 on an unknown name or bad value
+static int dg_set_option(char *opt) {
+
+  char *eq = strchr(opt, '=');
+  if (!eq) {
+    printf("error: datagen options are name=value, got %s\n", opt);
+    return 1;
+  }
+
+  *eq = '\0';
+  const char *name = opt;
+  const char *value = eq + 1;
+
+  if (!strcmp(name, "book")) {
+    snprintf(dg_book_buf, sizeof(dg_book_buf), "%s", value);
+    dg_book_path = dg_book_buf;
+    return 0;
+  }
+
+  if (!strcmp(name, "seed")) {
+    dg_run_seed = strtoull(value, NULL, 10);
+    dg_seed_given = 1;
+    return 0;
+  }
 
-#define VIRI_TYPE_NORMAL    0
-#define VIRI_TYPE_EP        1
-#define VIRI_TYPE_CASTLE    2
-#define VIRI_TYPE_PROMO     3
+  for (size_t i = 0; i < DG_NUM_OPTIONS; i++) {
+    const DatagenOption *o = &dg_options[i];
+    if (!strcmp(name, o->name)) {
+      const int v = atoi(value);
+      if (v < o->min || v > o->max) {
+        printf("error: %s must be in %d..%d\n", o->name, o->min, o->max);
+        return 1;
+      }
+      *(int *)((char *)&dg_cfg + o->offset) = v;
+      return 0;
+    }
+  }
 
-#define VIRI_WDL_BLACK_WIN  0
-#define VIRI_WDL_DRAW       1
-#define VIRI_WDL_WHITE_WIN  2
+  printf("error: unknown datagen option %s\n", name);
+  return 1;
 
-// --- RNG (xorshift64, local to datagen) ---
+}
 
-static uint64_t dg_seed;
+// --- RNG (xorshift64, local to each datagen worker) ---
+
+static _Thread_local uint64_t dg_seed;
+
+// splitmix64, spreads run seed, worker and game number over 64 bits
+static uint64_t dg_mix(uint64_t x) {
+  x += 0x9E3779B97F4A7C15ULL;
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+  return x ^ (x >> 31);
+}
 
-static void dg_seed_rng(void) {
-  uint64_t x;
-  dg_seed = time_ms() ^ (uint64_t)(uintptr_t)&x;
+// new_game clears every table, so a game depends only on its seed and book
+// line; seeding each attempt lets a resumed run replay it exactly
+static void dg_seed_game(const uint64_t worker_seed, const uint64_t attempt) {
+  dg_seed = dg_mix(worker_seed ^ dg_mix(attempt));
   if (!dg_seed) dg_seed = 1;
 }
 
@@ -55,159 +197,127 @@ static uint64_t dg_rand(void) {
   return dg_seed * 2685821657736338717ULL;
 }
 
-// --- viriformat: PackedBoard (32 bytes) ---
+// --- openings ---
 
-static void pos_to_packed_board(const Position *pos, uint8_t *buf, uint8_t wdl) {
+// set up nodes[0] from an epd/fen line: board stm rights ep [hmc fullmove]
+static int book_position(const char *line, int *fullmove) {
 
-  memset(buf, 0, 32);
+  char copy[256];
+  char *tokens[6];
+  int ntokens = 0;
 
-  // bytes 0-7: occupancy
-  uint64_t occ = pos->occupied;
-  memcpy(buf, &occ, 8);
-
-  // bytes 8-23: nibble-packed pieces
-  // walk set bits of occupancy, for each encode a 4-bit nibble
-  uint64_t tmp = occ;
-  int idx = 0;
-  while (tmp) {
-    int sq = bsf(tmp);
-    tmp &= tmp - 1;
-
-    uint8_t piece = pos->board[sq];
-    int color = piece_colour(piece);
-    int type = piece_type(piece);
-
-    // unmoved rook detection
-    if (type == ROOK) {
-      if (sq == H1 && (pos->rights & WHITE_RIGHTS_KING))  type = 6;
-      if (sq == A1 && (pos->rights & WHITE_RIGHTS_QUEEN)) type = 6;
-      if (sq == H8 && (pos->rights & BLACK_RIGHTS_KING))  type = 6;
-      if (sq == A8 && (pos->rights & BLACK_RIGHTS_QUEEN)) type = 6;
-    }
-
-    uint8_t nibble = (color << 3) | type;
-    int byte_idx = 8 + (idx / 2);
-    if (idx & 1)
-      buf[byte_idx] |= nibble << 4;
-    else
-      buf[byte_idx] = nibble;
-    idx++;
-  }
+  strncpy(copy, line, sizeof(copy) - 1);
+  copy[sizeof(copy) - 1] = '\0';
 
-  // byte 24: stm_ep_square
-  uint8_t ep = pos->ep ? pos->ep : 64;
-  buf[24] = (pos->stm << 7) | (ep & 0x7F);
+  for (char *t = strtok(copy, " \t;"); t && ntokens < 6; t = strtok(NULL, " \t;"))
+    tokens[ntokens++] = t;
 
-  // byte 25: halfmove clock
-  buf[25] = pos->hmc;
+  if (ntokens < 4)
+    return 1;
 
-  // bytes 26-27: fullmove number (0)
-  // bytes 28-29: eval (0)
+  // epd opcodes in place of the counters read as 0
+  const int hmc = ntokens > 4 ? atoi(tokens[4]) : 0;
+  *fullmove = ntokens > 5 ? atoi(tokens[5]) : 1;
+  if (*fullmove < 1)
+    *fullmove = 1;
 
-  // byte 30: wdl
-  buf[30] = wdl;
+  position(&nodes[0], tokens[0], tokens[1], tokens[2], tokens[3], hmc, 0, NULL);
 
-  // byte 31: extra (0)
+  return 0;
 
 }
 
-// --- viriformat: move conversion ---
+// book position (if any) then random plies; 1 if the opening is unusable
+static int play_opening(const uint64_t book_index, int *fullmove) {
 
-static uint16_t move_to_viri(move_t move) {
-
-  int from = (move >> 6) & 0x3F;
-  int to = move & 0x3F;
-  int type = VIRI_TYPE_NORMAL;
-  int promo = 0;
+  move_t legal[MAX_MOVES];
+  char line[256];
 
-  if (move & MOVE_FLAG_EPCAPTURE) {
-    type = VIRI_TYPE_EP;
+  if (dg_book.num_lines) {
+    book_line(&dg_book, book_index, line, sizeof(line));
+    if (book_position(line, fullmove))
+      return 1;
   }
-  else if (move & MOVE_FLAG_CASTLE) {
-    type = VIRI_TYPE_CASTLE;
-    // convert king destination to rook square (king-takes-rook)
-    if (to == G1) to = H1;
-    else if (to == C1) to = A1;
-    else if (to == G8) to = H8;
-    else if (to == C8) to = A8;
-  }
-  else if (move & MOVE_FLAG_PROMOTE) {
-    type = VIRI_TYPE_PROMO;
-    // cwtch promo piece: bits 13-12 of flags area = piece type (KNIGHT=1..QUEEN=4)
-    int piece = (move >> 12) & 0x7;
-    promo = piece - 1; // KNIGHT=0, BISHOP=1, ROOK=2, QUEEN=3
+  else {
+    position(&nodes[0], "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR", "w", "KQkq", "-", 0, 0, NULL);
+    *fullmove = 1;
   }
 
-  return (uint16_t)(from | (to << 6) | (promo << 12) | (type << 14));
+  // random opening: random_plies + 0 or 1 extra (to randomise stm)
+  int num_random = dg_cfg.random_plies ? dg_cfg.random_plies + (dg_rand() & 1) : 0;
 
-}
+  for (int i = 0; i < num_random; i++) {
+    int n = gen_legal_moves(&nodes[0].pos, legal);
+    if (n == 0)
+      return 1;
+
+    *fullmove += nodes[0].pos.stm == BLACK;
+    apply_move(&nodes[0], legal[dg_rand() % n]);
+    hh_push(nodes[0].pos.hash);
+  }
 
-// --- viriformat: move+score entry ---
+  if (is_mat_draw(&nodes[0].pos))
+    return 1;
 
-typedef struct {
-  uint16_t move;
-  int16_t score;
-} ViriMove;
+  if (!gen_legal_moves(&nodes[0].pos, legal))
+    return 1;
 
-// --- legal move generation ---
+  // quick static eval filter against lopsided openings
+  if (dg_cfg.open_eval && abs(net_eval(&nodes[0])) > dg_cfg.open_eval)
+    return 1;
 
-static int gen_legal_moves(move_t *legal) {
+  return 0;
 
-  Node *node = &nodes[0];
-  Position *pos = &node->pos;
-  const int stm = pos->stm;
-  const int opp = stm ^ 1;
-  const int king_idx = piece_index(KING, stm);
-  const int in_check = is_attacked(pos, bsf(pos->all[king_idx]), opp);
+}
 
-  init_next_search_move(node, in_check, 0);
+// --- sidecar ---
 
-  int count = 0;
-  move_t move;
-  Node tmp;
+// moves whose static eval beats the best move's; 0 when the search agrees
+// with the static eval, so a high rank marks a move only search finds
+static int best_move_rank(const move_t *legal, const int n, const move_t best) {
 
-  while ((move = get_next_search_move(node))) {
-    pos_copy(pos, &tmp.pos);
-    make_move(&tmp, move);
-    if (!is_attacked(&tmp.pos, bsf(tmp.pos.all[king_idx]), opp)) {
-      legal[count++] = move;
-    }
+  Node *child = &nodes[1];
+  int scores[MAX_MOVES];
+  int best_score = 0;
+
+  for (int i = 0; i < n; i++) {
+    pos_copy(&nodes[0].pos, &child->pos);
+    make_move(child, legal[i]);
+    child->accs_dirty = 1;
+    lazy_update_accs(child);
+    scores[i] = -net_eval(child);
+    if (legal[i] == best)
+      best_score = scores[i];
   }
 
-  return count;
+  int rank = 0;
+  for (int i = 0; i < n; i++)
+    rank += scores[i] > best_score;
+
+  return rank < 255 ? rank : 255;
 
 }
 
-// --- play one game, return number of moves written ---
+// --- play one game into a complete record, return number of moves ---
 
-static int play_game(FILE *fp) {
+static int play_game(uint8_t *buf, int *len, const uint64_t book_index, DatagenSide *side) {
 
   ViriMove entries[DG_MAX_GAME_MOVES];
   int num_entries = 0;
+  int fullmove = 1;
   move_t legal[MAX_MOVES];
 
   new_game();
-  position(&nodes[0], "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR", "w", "KQkq", "-", 0, 0, NULL);
 
-  // random opening: RANDOM_PLIES + 0 or 1 extra (to randomise stm)
-  int num_random = DG_RANDOM_PLIES + (dg_rand() & 1);
+  // node counts are flushed in batches; start every game from an empty
+  // batch so the node limit cuts searches at the same place on a resume
+  search_local_node_batch = 0;
+  qsearch_local_node_batch = 0;
 
-  for (int i = 0; i < num_random; i++) {
-    int n = gen_legal_moves(legal);
-    if (n == 0)
-      return 0;
-
-    move_t pick = legal[dg_rand() % n];
-    char buf[6];
-    format_move(pick, buf);
-    play_move(&nodes[0], buf);
-    hh_push(nodes[0].pos.hash);
-  }
-
-  if (is_mat_draw(&nodes[0].pos))
+  if (play_opening(book_index, &fullmove))
     return 0;
 
-  // save starting position (after random plies)
+  // save starting position (after the opening)
   Position start_pos;
   pos_copy(&nodes[0].pos, &start_pos);
 
@@ -216,7 +326,7 @@ static int play_game(FILE *fp) {
     int draw_count = 0;
     int adjudication_counter = 0; 
 
-    for (int ply = 0; ply < DG_MAX_GAME_MOVES; ply++) {
+    for (int ply = 0; ply < dg_cfg.max_moves; ply++) {
 
     Position *pos = &nodes[0].pos;
     const int stm = pos->stm;
@@ -224,7 +334,7 @@ static int play_game(FILE *fp) {
     const int king_idx = piece_index(KING, stm);
     const int in_check = is_attacked(pos, bsf(pos->all[king_idx]), opp);
 
-    int n = gen_legal_moves(legal);
+    int n = gen_legal_moves(pos, legal);
 
     if (n == 0) {
       if (in_check)
@@ -233,13 +343,14 @@ static int play_game(FILE *fp) {
     }
 
     // search
-    init_tc(0, 0, 0, 0, DG_SEARCH_NODES, 0, 0, 0);
-    time_control.best_move = 0;
-    time_control.best_score = 0;
+    const int batched = search_local_node_batch + qsearch_local_node_batch;
+    init_tc(0, 0, 0, 0, dg_cfg.nodes, 0, 0, 0);
+    thread_tc->best_move = 0;
+    thread_tc->best_score = 0;
     go(1);
 
-    move_t best = time_control.best_move;
-    int score = time_control.best_score;
+    move_t best = thread_tc->best_move;
+    int score = thread_tc->best_score;
 
     if (!best)
       best = legal[0];
@@ -248,29 +359,36 @@ static int play_game(FILE *fp) {
 
     // record move + score
     if (num_entries < DG_MAX_GAME_MOVES) {
+      if (side) {
+        DatagenSide *sd = &side[num_entries];
+        sd->nodes = (uint32_t)(thread_tc->nodes + search_local_node_batch + qsearch_local_node_batch - batched);
+        sd->depth = (uint8_t)thread_tc->depth;
+        sd->rank = (uint8_t)best_move_rank(legal, n, best);
+        sd->reserved = 0;
+      }
       entries[num_entries].move = move_to_viri(best);
       entries[num_entries].score = (int16_t)white_score;
       num_entries++;
     }
 
 // adjudication (draws)
-    if (abs(score) <= DG_DRAW_SCORE)
+    if (abs(score) <= dg_cfg.draw_score)
         draw_count++;
     else
         draw_count = 0;
 
-    if (draw_count >= DG_DRAW_COUNT && ply >= DG_DRAW_PLY) {
+    if (draw_count >= dg_cfg.draw_count && ply >= dg_cfg.draw_ply) {
         wdl = VIRI_WDL_DRAW;
         break;
     }
 
     // adjudication (resignations)
-    // If one side is completely crushing the other (1500+ centipawns)
-    if (abs(score) > 1500) {
+    // If one side is completely crushing the other (win_score+ centipawns)
+    if (abs(score) > dg_cfg.win_score) {
         adjudication_counter++;
 
-        // If the massive lead holds for 3 consecutive half-moves
-        if (adjudication_counter >= 3) {
+        // If the massive lead holds for win_count consecutive half-moves
+        if (adjudication_counter >= dg_cfg.win_count) {
             // Record the win/loss before breaking!
             if (score > 0) {
                 // We are winning! The winner is whoever is currently moving.
@@ -286,9 +404,7 @@ static int play_game(FILE *fp) {
         adjudication_counter = 0;
     }
     // play the move
-    char buf[6];
-    format_move(best, buf);
-    play_move(&nodes[0], buf);
+    apply_move(&nodes[0], best);
     hh_push(nodes[0].pos.hash);
 
     // draw checks
@@ -305,98 +421,599 @@ static int play_game(FILE *fp) {
 
   // build complete game record in one buffer
   // 32 (PackedBoard) + 4 * num_entries (moves) + 4 (terminator)
-  uint8_t buf[32 + DG_MAX_GAME_MOVES * 4 + 4];
-  int len = 0;
+  int n = 0;
 
-  pos_to_packed_board(&start_pos, buf, wdl);
-  len += 32;
+  pos_to_packed_board(&start_pos, buf, wdl, fullmove, entries[0].score);
+  n += 32;
 
-  memcpy(buf + len, entries, 4 * num_entries);
-  len += 4 * num_entries;
+  memcpy(buf + n, entries, 4 * num_entries);
+  n += 4 * num_entries;
 
-  memset(buf + len, 0, 4);
-  len += 4;
+  memset(buf + n, 0, 4);
+  n += 4;
 
-  fwrite(buf, len, 1, fp);
+  *len = n;
 
   return num_entries;
 
 }
 
-// --- main datagen loop ---
+// --- workers ---
 
-void datagen(const char *directory, uint64_t target_positions) {
 
-  dg_seed_rng();
+typedef struct DatagenShared DatagenShared;
 
-  char filename[512];
-  snprintf(filename, sizeof(filename), "%s/" DG_FILE_PREFIX "%llu.vf",
-    directory, (unsigned long long)dg_rand());
+// one worker and the shard it writes; the counters cover complete games
+// pushed to the writer and are guarded by the shared lock
+typedef struct {
+  DatagenShared *shared;
+  int id;
+  uint64_t seed;
+  char filename[64];
+  uint64_t base_bytes;  // already in the shard when this session started
+  uint64_t base_positions;
+  uint64_t bytes;
+  uint64_t games;
+  uint64_t positions;
+  uint64_t attempts;    // games started, including rejected openings
+} DatagenWorker;
+
+// progress shared by all workers; each worker feeds its own file through
+// the writer thread
+struct DatagenShared {
+  Writer writer;
+  const char *directory;
+  uint64_t seed;
+  uint64_t target_positions;
+  uint64_t start_time;
+  uint64_t start_positions;
+  int num_workers;
+  DatagenWorker *workers;
+  pthread_mutex_t lock;
+  _Atomic uint64_t positions;
+  _Atomic uint64_t games;
+  _Atomic int failed;        // a worker gave up, stop everyone
+  _Atomic int book_wrapped;  // the book has been used up once
+};
+
+static void report_progress(DatagenShared *ds, const uint64_t now) {
+
+  const uint64_t total_positions = atomic_load(&ds->positions);
+  const uint64_t total_games = atomic_load(&ds->games);
+  const uint64_t target_positions = ds->target_positions;
+  uint64_t elapsed = now - ds->start_time;
+  uint64_t session_positions = total_positions - ds->start_positions;
+  uint64_t pps = elapsed ? (session_positions * 1000ULL / elapsed) : 0;
+  uint64_t remaining_pos = target_positions > total_positions
+    ? target_positions - total_positions : 0;
+  uint64_t eta_ms = pps ? (remaining_pos * 1000ULL / pps) : 0;
+  double pct = target_positions ? (100.0 * total_positions / target_positions) : 0.0;
+
+  int eta_s = (int)(eta_ms / 1000ULL);
+  int eta_d = eta_s / 86400;
+  int eta_h = (eta_s % 86400) / 3600;
+  int eta_m = (eta_s % 3600) / 60;
+
+  char eta[32];
+  if (eta_d > 0)
+    snprintf(eta, sizeof eta, "%dd %02d:%02d", eta_d, eta_h, eta_m);
+  else
+    snprintf(eta, sizeof eta, "%d:%02d", eta_h, eta_m);
+
+  printf("datagen: %llu/%llu positions (%.1f%%) %llu games %llu pos/s [%s left]\n",
+    (unsigned long long)total_positions,
+    (unsigned long long)target_positions,
+    pct,
+    (unsigned long long)total_games,
+    (unsigned long long)pps,
+    eta);
+  fflush(stdout);
 
-  FILE *fp = fopen(filename, "wb");
+}
+
+// --- manifest ---
+
+static void dg_fsync(FILE *fp) {
+
+  fflush(fp);
+
+#ifdef _WIN32
+  _commit(_fileno(fp));
+#else
+  fsync(fileno(fp));
+#endif
+
+}
+
+// write to a temporary file and rename it over the old manifest, so a crash
+// leaves either the previous checkpoint or the new one
+static int dg_write_manifest(const DatagenShared *ds, const DatagenWorker *shards) {
+
+  char path[512];
+  char tmp[520];
+  snprintf(path, sizeof(path), "%s/" DG_MANIFEST, ds->directory);
+  snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+  FILE *fp = fopen(tmp, "w");
   if (!fp) {
-    printf("error: cannot open %s\n", filename);
-    return;
+    printf("error: cannot write %s\n", tmp);
+    return 1;
+  }
+
+  fprintf(fp, "%s %d\n", DG_MANIFEST_MAGIC, DG_MANIFEST_VERSION);
+  fprintf(fp, "seed %llu\n", (unsigned long long)ds->seed);
+  fprintf(fp, "target %llu\n", (unsigned long long)ds->target_positions);
+  fprintf(fp, "workers %d\n", ds->num_workers);
+
+  for (size_t i = 0; i < DG_NUM_OPTIONS; i++)
+    fprintf(fp, "option %s=%d\n", dg_options[i].name, *(const int *)((const char *)&dg_cfg + dg_options[i].offset));
+
+  if (dg_book_path)
+    fprintf(fp, "option book=%s\n", dg_book_path);
+
+  // shard <id> <file> <bytes> <games> <positions> <attempts>
+  for (int i = 0; i < ds->num_workers; i++) {
+    const DatagenWorker *w = &shards[i];
+    fprintf(fp, "shard %d %s %llu %llu %llu %llu\n", w->id, w->filename,
+      (unsigned long long)w->bytes,
+      (unsigned long long)w->games,
+      (unsigned long long)w->positions,
+      (unsigned long long)w->attempts);
+  }
+
+  dg_fsync(fp);
+  fclose(fp);
+
+#ifdef _WIN32
+  remove(path);
+#endif
+
+  if (rename(tmp, path)) {
+    printf("error: cannot replace %s\n", path);
+    return 1;
+  }
+
+  return 0;
+
+}
+
+// fill ds and workers from a manifest and apply its options; 1 on error
+static int dg_read_manifest(const char *directory, DatagenShared *ds, DatagenWorker *workers) {
+
+  char path[512];
+  char line[1024];
+  snprintf(path, sizeof(path), "%s/" DG_MANIFEST, directory);
+
+  FILE *fp = fopen(path, "r");
+  if (!fp) {
+    printf("error: cannot open %s\n", path);
+    return 1;
   }
 
-  static char iobuf[1 << 20];
-  setvbuf(fp, iobuf, _IOFBF, sizeof(iobuf));
-
-  printf("datagen: writing to %s, target %llu positions\n",
-    filename, (unsigned long long)target_positions);
-
-  uint64_t start_time = time_ms();
-  uint64_t total_positions = 0;
-  uint64_t total_games = 0;
-  uint64_t last_report = start_time;
-
-  // stop once the target position count is reached; the current game always
-  // completes, so the final file slightly overshoots the target.
-  while (total_positions < target_positions) {
-
-    int moves = play_game(fp);
-    total_positions += moves;
-    total_games++;
-
-    uint64_t now = time_ms();
-    if (now - last_report >= DG_REPORT_SECS * 1000) {
-      uint64_t elapsed = now - start_time;
-      uint64_t pps = elapsed ? (total_positions * 1000ULL / elapsed) : 0;
-      uint64_t remaining_pos = target_positions > total_positions
-        ? target_positions - total_positions : 0;
-      uint64_t eta_ms = pps ? (remaining_pos * 1000ULL / pps) : 0;
-      double pct = target_positions ? (100.0 * total_positions / target_positions) : 0.0;
-
-      int eta_s = (int)(eta_ms / 1000ULL);
-      int eta_d = eta_s / 86400;
-      int eta_h = (eta_s % 86400) / 3600;
-      int eta_m = (eta_s % 3600) / 60;
-
-      char eta[32];
-      if (eta_d > 0)
-        snprintf(eta, sizeof eta, "%dd %02d:%02d", eta_d, eta_h, eta_m);
-      else
-        snprintf(eta, sizeof eta, "%d:%02d", eta_h, eta_m);
-
-      printf("datagen: %llu/%llu positions (%.1f%%) %llu games %llu pos/s [%s left]\n",
-        (unsigned long long)total_positions,
-        (unsigned long long)target_positions,
-        pct,
-        (unsigned long long)total_games,
-        (unsigned long long)pps,
-        eta);
-      fflush(stdout);
-      fflush(fp);
-      last_report = now;
+  int version = 0;
+  int num_shards = 0;
+  int bad = 0;
+  char magic[32] = {0};
+
+  if (!fgets(line, sizeof(line), fp) || sscanf(line, "%31s %d", magic, &version) != 2
+      || strcmp(magic, DG_MANIFEST_MAGIC) || version != DG_MANIFEST_VERSION) {
+    printf("error: %s is not a datagen manifest\n", path);
+    fclose(fp);
+    return 1;
+  }
+
+  while (!bad && fgets(line, sizeof(line), fp)) {
+
+    line[strcspn(line, "\r\n")] = '\0';
+
+    unsigned long long a, b, c, d;
+    int id;
+    char name[64];
+
+    if (sscanf(line, "seed %llu", &a) == 1)
+      ds->seed = a;
+    else if (sscanf(line, "target %llu", &a) == 1)
+      ds->target_positions = a;
+    else if (sscanf(line, "workers %d", &ds->num_workers) == 1)
+      bad = ds->num_workers < 1 || ds->num_workers > DG_MAX_THREADS;
+    else if (!strncmp(line, "option ", 7))
+      bad = dg_set_option(line + 7);
+    else if (sscanf(line, "shard %d %63s %llu %llu %llu %llu", &id, name, &a, &b, &c, &d) == 6) {
+      if (id < 0 || id >= DG_MAX_THREADS || id != num_shards) {
+        bad = 1;
+        break;
+      }
+      DatagenWorker *w = &workers[id];
+      snprintf(w->filename, sizeof(w->filename), "%s", name);
+      w->bytes = a;
+      w->games = b;
+      w->positions = c;
+      w->attempts = d;
+      num_shards++;
     }
+    else if (line[0])
+      bad = 1;
 
   }
 
   fclose(fp);
 
-  printf("datagen: done. %llu positions %llu games written to %s\n",
-    (unsigned long long)total_positions,
-    (unsigned long long)total_games,
-    filename);
+  if (bad || !ds->num_workers || num_shards != ds->num_workers) {
+    printf("error: %s is damaged\n", path);
+    return 1;
+  }
+
+  return 0;
+
+}
+
+// snapshot every shard, wait until the writer has put those bytes on disk
+// and only then replace the manifest, so it never claims more than the
+// shards hold
+// runs on the writer thread so no worker waits for the disk
+static void dg_checkpoint(void *arg) {
+
+  DatagenShared *ds = (DatagenShared *)arg;
+  DatagenWorker shards[DG_MAX_THREADS];
+
+  pthread_mutex_lock(&ds->lock);
+  memcpy(shards, ds->workers, ds->num_workers * sizeof(DatagenWorker));
+  pthread_mutex_unlock(&ds->lock);
+
+  for (int i = 0; i < ds->num_workers; i++) {
+    if (writer_sync(&ds->writer, i, shards[i].bytes - shards[i].base_bytes))
+      return;
+    if (dg_cfg.sidecar && writer_sync(&ds->writer, ds->num_workers + i,
+        (shards[i].positions - shards[i].base_positions) * sizeof(DatagenSide)))
+      return;
+  }
+
+  dg_write_manifest(ds, shards);
+
+}
+
+// cut a shard back to what the manifest vouches for; a partial trailing
+// game and any games newer than the checkpoint (which are replayed) go
+static int dg_truncate_shard(FILE *fp, const uint64_t bytes) {
+
+#ifdef _WIN32
+  if (_fseeki64(fp, 0, SEEK_END))
+    return 1;
+  const uint64_t size = (uint64_t)_ftelli64(fp);
+#else
+  if (fseeko(fp, 0, SEEK_END))
+    return 1;
+  const uint64_t size = (uint64_t)ftello(fp);
+#endif
+
+  if (size < bytes) {
+    printf("error: shard holds %llu bytes, manifest expects %llu\n",
+      (unsigned long long)size, (unsigned long long)bytes);
+    return 1;
+  }
+
+  if (size > bytes)
+    printf("datagen: dropping %llu bytes written after the last checkpoint\n",
+      (unsigned long long)(size - bytes));
+
+#ifdef _WIN32
+  if (_chsize_s(_fileno(fp), (long long)bytes))
+    return 1;
+  return _fseeki64(fp, (long long)bytes, SEEK_SET) != 0;
+#else
+  if (ftruncate(fileno(fp), (off_t)bytes))
+    return 1;
+  return fseeko(fp, (off_t)bytes, SEEK_SET) != 0;
+#endif
+
+}
+
+// open a shard for writing; on a resume cut it back to bytes first
+static FILE *dg_open_shard(const char *filename, const int resume, const uint64_t bytes) {
+
+  FILE *fp = fopen(filename, resume ? "r+b" : "wb");
+
+  if (fp && resume && dg_truncate_shard(fp, bytes)) {
+    fclose(fp);
+    fp = NULL;
+  }
+
+  if (!fp)
+    printf("error: cannot open %s\n", filename);
+
+  return fp;
+
+}
+
+// data<seed>_<worker>.vf (or .cbp) -> data<seed>_<worker>.side
+static void dg_side_name(char *filename) {
+
+  char *dot = strrchr(filename, '.');
+
+  if (dot && !strchr(dot, '/'))
+    strcpy(dot, ".side");
+
+}
+
+static void dg_close_files(FILE **files, const int n) {
+
+  for (int i = 0; i < n; i++) {
+    if (files[i])
+      fclose(files[i]);
+  }
+
+}
+
+// --- workers ---
+
+static void *datagen_worker(void *arg) {
+
+  DatagenWorker *w = (DatagenWorker *)arg;
+  DatagenShared *ds = w->shared;
+  uint8_t record[DG_RECORD_BYTES];
+  uint8_t packed[BINPACK_MAX_BYTES(DG_MAX_GAME_MOVES)];
+  DatagenSide side[DG_MAX_GAME_MOVES];
+  int len;
+
+  if (go_private_init(dg_cfg.hash_mb)) {
+    printf("error: worker %d cannot allocate search state\n", w->id);
+    return NULL;
+  }
+
+  net_init_thread();
+  clear_nodes();
+
+  uint64_t last_report = time_ms();
+  int fails = 0;
+
+  // stop once the shared target is reached; the current game always
+  // completes, so the total slightly overshoots the target.
+  while (!atomic_load(&ds->failed) && atomic_load(&ds->positions) < ds->target_positions) {
+
+    // attempt a of worker i plays book line i + a * n, wrapping at the end
+    const uint64_t book_index = w->id + w->attempts * ds->num_workers;
+
+    if (dg_book.num_lines && book_index >= dg_book.num_lines && !atomic_exchange(&ds->book_wrapped, 1))
+      printf("datagen: book exhausted after %llu lines, reusing them from the start\n", (unsigned long long)dg_book.num_lines);
+
+    dg_seed_game(w->seed, w->attempts);
+    int moves = play_game(record, &len, book_index, dg_cfg.sidecar ? side : NULL);
+    const uint8_t *out = record;
+
+    if (moves && dg_cfg.binpack) {
+      len = (int)binpack_game(record, len, packed);
+      out = packed;
+      if (!len)
+        moves = 0;
+    }
+
+    // the writer reports the short write itself; the game is not counted
+    // and the manifest keeps the last checkpoint
+    if (moves && (writer_push(&ds->writer, w->id, out, len) ||
+        (dg_cfg.sidecar && writer_push(&ds->writer, ds->num_workers + w->id, side, moves * sizeof(DatagenSide))))) {
+      atomic_store(&ds->failed, 1);
+      break;
+    }
+
+    pthread_mutex_lock(&ds->lock);
+    w->attempts++;
+    if (moves) {
+      w->bytes += len;
+      w->games++;
+      w->positions += moves;
+    }
+    pthread_mutex_unlock(&ds->lock);
+
+    if (moves) {
+      atomic_fetch_add(&ds->positions, moves);
+      atomic_fetch_add(&ds->games, 1);
+      fails = 0;
+    }
+    else if (++fails >= DG_MAX_FAILS) {
+      printf("error: worker %d got no game from %d attempts in a row, check open_eval and the book\n", w->id, fails);
+      atomic_store(&ds->failed, 1);
+    }
+
+    if (w->id == 0) {
+      uint64_t now = time_ms();
+      if (now - last_report >= DG_REPORT_SECS * 1000) {
+        report_progress(ds, now);
+        last_report = now;
+      }
+    }
+
+  }
+
+  go_private_free();
+
+  return NULL;
+
+}
+
+// --- main datagen loop ---
+
+// open the shards, run the workers and keep the manifest up to date
+static void dg_run(DatagenShared *ds, DatagenWorker *workers, const int resume) {
+
+  FILE *files[2 * DG_MAX_THREADS] = {0};
+  pthread_t handles[DG_MAX_THREADS];
+  const int threads = ds->num_workers;
+  const int num_files = dg_cfg.sidecar ? 2 * threads : threads;
+
+  if (dg_book_path) {
+    if (book_open(&dg_book, dg_book_path))
+      return;
+    printf("datagen: book %s, %llu positions\n", dg_book_path, (unsigned long long)dg_book.num_lines);
+  }
+
+  for (int i = 0; i < threads; i++) {
+
+    DatagenWorker *w = &workers[i];
+    w->shared = ds;
+    w->id = i;
+    w->seed = dg_mix(ds->seed + i);
+    w->base_bytes = w->bytes;
+    w->base_positions = w->positions;
+
+    atomic_fetch_add(&ds->positions, w->positions);
+    atomic_fetch_add(&ds->games, w->games);
+
+    char filename[512];
+    snprintf(filename, sizeof(filename), "%s/%s", ds->directory, w->filename);
+
+    files[i] = dg_open_shard(filename, resume, w->bytes);
+    if (!files[i])
+      break;
+
+    printf("datagen: worker %d writing to %s\n", i, filename);
+
+    if (dg_cfg.sidecar) {
+      dg_side_name(filename);
+      files[threads + i] = dg_open_shard(filename, resume, w->positions * sizeof(DatagenSide));
+      if (!files[threads + i])
+        break;
+    }
+
+  }
+
+  for (int i = 0; i < num_files; i++) {
+    if (!files[i]) {
+      dg_close_files(files, num_files);
+      book_close(&dg_book);
+      return;
+    }
+  }
+
+  ds->start_positions = atomic_load(&ds->positions);
+
+  pthread_mutex_init(&ds->lock, NULL);
+  ds->workers = workers;
+
+  // a run that crashes before its first checkpoint can still be resumed;
+  // after that the writer thread keeps the manifest up to date
+  if (dg_write_manifest(ds, workers) ||
+      writer_start(&ds->writer, files, num_files, dg_cfg.fsync_secs, dg_cfg.checkpoint_secs, dg_checkpoint, ds)) {
+    printf("error: cannot start writer\n");
+    pthread_mutex_destroy(&ds->lock);
+    dg_close_files(files, num_files);
+    book_close(&dg_book);
+    return;
+  }
+
+  // each worker searches single threaded
+  const int saved_threads = num_threads;
+  num_threads = 1;
+
+  printf("datagen: %d workers, target %llu positions, seed %llu\n",
+    threads, (unsigned long long)ds->target_positions, (unsigned long long)ds->seed);
+  printf("datagen: random_plies %d nodes %d draw %d/%d/%d win %d/%d max_moves %d open_eval %d hash %d fsync %d sidecar %d binpack %d\n",
+    dg_cfg.random_plies, dg_cfg.nodes, dg_cfg.draw_score, dg_cfg.draw_count, dg_cfg.draw_ply,
+    dg_cfg.win_score, dg_cfg.win_count, dg_cfg.max_moves, dg_cfg.open_eval, dg_cfg.hash_mb, dg_cfg.fsync_secs, dg_cfg.sidecar, dg_cfg.binpack);
+  if (resume)
+    printf("datagen: resuming at %llu positions\n", (unsigned long long)ds->start_positions);
+  fflush(stdout);
+
+  ds->start_time = time_ms();
+
+  for (int i = 1; i < threads; i++)
+    pthread_create(&handles[i], NULL, datagen_worker, &workers[i]);
+
+  // the calling thread is worker 0 and reports progress
+  datagen_worker(&workers[0]);
+
+  for (int i = 1; i < threads; i++)
+    pthread_join(handles[i], NULL);
+
+  num_threads = saved_threads;
+
+  // the writer's last checkpoint records the final shard sizes
+  if (writer_stop(&ds->writer)) {
+    atomic_store(&ds->failed, 1);
+    printf("error: could not write to %s, the manifest holds the last good checkpoint\n", ds->directory);
+  }
+  pthread_mutex_destroy(&ds->lock);
+
+  dg_close_files(files, num_files);
+  book_close(&dg_book);
+
+  printf("datagen: %s. %llu positions %llu games written to %s\n",
+    atomic_load(&ds->failed) ? "stopped" : "done",
+    (unsigned long long)atomic_load(&ds->positions),
+    (unsigned long long)atomic_load(&ds->games),
+    ds->directory);
+
+}
+
+void datagen(const char *directory, uint64_t target_positions, int threads, int num_opts, char **opts) {
+
+  static DatagenWorker workers[DG_MAX_THREADS];
+  DatagenShared ds;
+  char path[512];
+
+  if (threads < 1) threads = 1;
+  if (threads > DG_MAX_THREADS) threads = DG_MAX_THREADS;
+
+  dg_default_config();
+
+  for (int i = 0; i < num_opts; i++) {
+    if (dg_set_option(opts[i]))
+      return;
+  }
+
+  // one run per directory; its manifest is what resume picks up
+  snprintf(path, sizeof(path), "%s/" DG_MANIFEST, directory);
+  FILE *fp = fopen(path, "r");
+  if (fp) {
+    fclose(fp);
+    printf("error: %s already holds a run, use datagen %s resume\n", directory, directory);
+    return;
+  }
+
+  if (!dg_seed_given) {
+    uint64_t x;
+    dg_run_seed = dg_mix(time_ms() ^ (uint64_t)(uintptr_t)&x);
+  }
+
+  memset(&ds, 0, sizeof(ds));
+  memset(workers, 0, sizeof(workers));
+  ds.directory = directory;
+  ds.seed = dg_run_seed;
+  ds.target_positions = target_positions;
+  ds.num_workers = threads;
+
+  for (int i = 0; i < threads; i++)
+    snprintf(workers[i].filename, sizeof(workers[i].filename), DG_FILE_PREFIX "%llu_%d%s",
+      (unsigned long long)ds.seed, i, dg_cfg.binpack ? BINPACK_EXT : ".vf");
+
+  dg_run(&ds, workers, 0);
+
+}
+
+// continue the run recorded in directory's manifest with the same seed,
+// workers and options; games are replayed from each shard's checkpoint
+void datagen_resume(const char *directory) {
+
+  static DatagenWorker workers[DG_MAX_THREADS];
+  DatagenShared ds;
+
+  dg_default_config();
+
+  memset(&ds, 0, sizeof(ds));
+  memset(workers, 0, sizeof(workers));
+  ds.directory = directory;
+
+  if (dg_read_manifest(directory, &ds, workers))
+    return;
+
+  uint64_t done = 0;
+  for (int i = 0; i < ds.num_workers; i++)
+    done += workers[i].positions;
+
+  if (done >= ds.target_positions) {
+    printf("datagen: run in %s is already complete\n", directory);
+    return;
+  }
+
+  dg_run(&ds, workers, 1);
 
 }
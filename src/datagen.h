@@ -3,6 +3,16 @@
 
 #include <stdint.h>
 
-void datagen(const char *directory, uint64_t target_positions);
+// optional sidecar (sidecar=1): one record per position of the matching .vf
+// shard, in the same order
+typedef struct {
+  uint32_t nodes;     // searched for this position
+  uint8_t depth;      // last completed iteration
+  uint8_t rank;       // moves with a better static eval than the best move
+  uint16_t reserved;
+} DatagenSide;
+
+void datagen(const char *directory, uint64_t target_positions, int threads, int num_opts, char **opts);
+void datagen_resume(const char *directory);
 
 #endif
@@ -25,7 +25,9 @@ void debug_verify(int enable, Node *node, int ply) {
   lazy_update_accs(node);  // node may still be lazy at verify points
 
   Node verify_node;
+  NodeAccs verify_accs;
   verify_node.pos = *pos;
+  verify_node.accs = verify_accs.accs;
   net_slow_rebuild_accs(&verify_node);
   for (int i = 0; i < NET_H1_SIZE; i++) {
     if (node->accs[0][i] != verify_node.accs[0][i]) {
@@ -1,6 +1,8 @@
 #include <stdio.h>
 #include <pthread.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 #include "timecontrol.h"
 #include "search.h"
 #include "go.h"
@@ -11,17 +13,51 @@
 #include "uci.h"
 #include "pos.h"
 #include "net.h"
+#include "tt.h"
+#include "corrhist.h"
+#include "profile.h"
+#include "stats.h"
+#include "trace.h"
 
 extern int num_threads; // Bring in the thread count from uci.c
 
-Position root_pos;
+// what a helper thread inherits from the thread that called go()
+typedef struct {
+  int thread_id;
+  int quiet;
+  const Position *root_pos;
+  TimeControl *tc;
+  TTable *tt;
+  History *hist;
+  CorrHist *corr;
+  HH *hh;
+} SearchThread;
+
+// the state a thread used before go_private_init, restored by go_private_free
+static _Thread_local SearchThread saved_state;
 
 // This is the function that EVERY thread will run independently
 void* search_worker(void* arg) {
-  int thread_id = (int)(intptr_t)arg;
-  TimeControl *tc = &time_control;
+  const SearchThread *st = (const SearchThread *)arg;
+  const int thread_id = st->thread_id;
+
+  thread_tc = st->tc;
+  thread_tt = st->tt;
+  thread_hist = st->hist;
+  thread_corr = st->corr;
+  thread_hh = st->hh;
+
+  TimeControl *tc = thread_tc;
   int alpha = 0, beta = 0, delta = 0, score = 0;
 
+  // profile runs count each thread's hardware events separately
+  ProfSet prof;
+  const int profiling = prof_threads && !prof_open(&prof);
+  if (profiling)
+    prof_start(&prof);
+
+  trace_thread_start(st->quiet ? -1 : thread_id);
+
   // Only the main thread (0) resets the global root history
   if (thread_id == 0) {
     hh_set_root();
@@ -29,7 +65,7 @@ void* search_worker(void* arg) {
   
   // Every thread clears its own _Thread_local nodes stack
   clear_nodes();
-  pos_copy(&root_pos, &nodes[0].pos);
+  pos_copy(st->root_pos, &nodes[0].pos);
   
   net_init_thread();                // 1. Initialize the thread's local Finny cache
   net_slow_rebuild_accs(&nodes[0]); // 2. Build the root position accumulator from scratch
@@ -60,7 +96,9 @@ void* search_worker(void* arg) {
     // ONLY thread 0 prints to the UCI console. 
     // Helper threads stay completely silent to not crash the GUI.
     if (thread_id == 0 && !tc->finished) {
-      report(depth);
+      tc->depth = depth;
+      if (!st->quiet)
+        report(depth);
     }
 
     if (tc->finished) break;
@@ -69,25 +107,43 @@ void* search_worker(void* arg) {
     check_tc_nodes(); 
     if (tc->finished) break;
   }
+
+  if (profiling) {
+    prof_stop(&prof, &prof_thread_counts[thread_id]);
+    prof_close(&prof);
+  }
+
+  STAT_FLUSH();
+  trace_ring = NULL;
   
   return NULL;
 }
 
 void go(int silent) {
   pthread_t threads[256]; // Support up to 256 threads
-  time_control.finished = 0;
+  SearchThread args[256];
+  TimeControl *tc = thread_tc;
+  Position root_pos;
+  tc->finished = 0;
   pos_copy(&nodes[0].pos, &root_pos);
 
+  // threads with private state (datagen workers) are not the uci console
+  const int quiet = saved_state.tc != NULL;
+
+  for (int i = 0; i < num_threads; i++) {
+    args[i] = (SearchThread){i, quiet, &root_pos, thread_tc, thread_tt, thread_hist, thread_corr, thread_hh};
+  }
+
   // 1. Spawn helper threads (IDs 1 through num_threads - 1)
   for (int i = 1; i < num_threads; i++) {
-    pthread_create(&threads[i], NULL, search_worker, (void*)(intptr_t)i);
+    pthread_create(&threads[i], NULL, search_worker, &args[i]);
   }
 
   // 2. The main thread acts as Thread 0 and does the work too
-  search_worker((void*)(intptr_t)0);
+  search_worker(&args[0]);
 
   // 3. When Thread 0 finishes (either found mate or ran out of time),
-  // time_control.finished will be set to 1. We must wait for helpers to exit.
+  // tc->finished will be set to 1. We must wait for helpers to exit.
   for (int i = 1; i < num_threads; i++) {
     pthread_join(threads[i], NULL);
   }
@@ -95,9 +151,52 @@ void go(int silent) {
   // 4. Report the best move
   if (!silent) {
     char bm_str[6];
-    format_move(time_control.best_move, bm_str);
+    format_move(tc->best_move, bm_str);
     printf("bestmove %s\n", bm_str);
 
     fflush(stdout);
   }
-}
\ No newline at end of file
+
+  // saving the rings takes a while, so only once the move is out
+  if (!quiet)
+    trace_write_go(num_threads);
+}
+
+// give the calling thread its own tt, histories and game history so it can
+// search independently of the uci state; datagen workers use this
+int go_private_init(const size_t hash_mb) {
+
+  saved_state = (SearchThread){0, 1, NULL, thread_tc, thread_tt, thread_hist, thread_corr, thread_hh};
+
+  thread_tc = calloc(1, sizeof(TimeControl));
+  thread_tt = tt_new_private(hash_mb);
+  thread_hist = calloc(1, sizeof(History));
+  thread_corr = calloc(1, sizeof(CorrHist));
+  thread_hh = hh_new_private();
+
+  if (!thread_tc || !thread_tt || !thread_hist || !thread_corr || !thread_hh) {
+    go_private_free();
+    return 1;
+  }
+
+  return 0;
+
+}
+
+void go_private_free(void) {
+
+  free(thread_tc);
+  tt_free_private(thread_tt);
+  free(thread_hist);
+  free(thread_corr);
+  hh_free_private(thread_hh);
+
+  thread_tc = saved_state.tc;
+  thread_tt = saved_state.tt;
+  thread_hist = saved_state.hist;
+  thread_corr = saved_state.corr;
+  thread_hh = saved_state.hh;
+
+  memset(&saved_state, 0, sizeof(SearchThread));
+
+}
@@ -1,6 +1,10 @@
 #ifndef GO_H
 #define GO_H
 
+#include <stddef.h>
+
 void go(int silent);
+int go_private_init(const size_t hash_mb);
+void go_private_free(void);
 
 #endif
\ No newline at end of file
@@ -1,27 +1,44 @@
+#include <stdlib.h>
 #include "hh.h"
 
-static uint64_t hashes[MAX_HH];
-static int game_ply;
-static int root_ply;
+struct HH {
+  uint64_t hashes[MAX_HH];
+  int game_ply;
+  int root_ply;
+};
+
+static HH hh_shared;
+_Thread_local HH *thread_hh = &hh_shared;
+
+HH *hh_new_private(void) {
+  return calloc(1, sizeof(HH));
+}
+
+void hh_free_private(HH *h) {
+  if (h != &hh_shared)
+    free(h);
+}
 
 void hh_reset(void) {
-  game_ply = 0;
-  root_ply = 0;
+  thread_hh->game_ply = 0;
+  thread_hh->root_ply = 0;
 }
 
 void hh_push(uint64_t hash) {
-  if (game_ply < MAX_HH)
-    hashes[game_ply++] = hash;
+  HH *h = thread_hh;
+  if (h->game_ply < MAX_HH)
+    h->hashes[h->game_ply++] = hash;
 }
 
 void hh_set_root(void) {
-  root_ply = game_ply - 1;
+  thread_hh->root_ply = thread_hh->game_ply - 1;
 }
 
 void hh_store(int search_ply, uint64_t hash) {
-  int idx = root_ply + search_ply;
+  HH *h = thread_hh;
+  int idx = h->root_ply + search_ply;
   if (idx < MAX_HH)
-    hashes[idx] = hash;
+    h->hashes[idx] = hash;
 }
 
 int is_draw(int search_ply, uint64_t hash, int hmc) {
@@ -30,6 +47,10 @@ int is_draw(int search_ply, uint64_t hash, int hmc) {
   if (hmc >= 100)
     return 1;
 
+  const HH *h = thread_hh;
+  const uint64_t *hashes = h->hashes;
+  const int root_ply = h->root_ply;
+
   // current absolute index
   int current = root_ply + search_ply;
   if (current >= MAX_HH)
@@ -5,6 +5,12 @@
 
 #define MAX_HH 1024
 
+typedef struct HH HH;
+
+extern _Thread_local HH *thread_hh;  // shared by smp threads unless the thread owns one
+
+HH *hh_new_private(void);
+void hh_free_private(HH *h);
 void hh_reset(void);
 void hh_push(uint64_t hash);
 void hh_set_root(void);
@@ -7,10 +7,8 @@
 #include "move.h"
 #include "nodes.h"
 
-int16_t piece_to_history[12][64];
-int16_t cont_history[12][64][12][64];
-int16_t capture_history[12][64][6];
-move_t counter_moves[12][64];
+static History history_shared;
+_Thread_local History *thread_hist = &history_shared;
 
 // gravity self-bounds to +/-MAX_HISTORY for |bonus| <= MAX_HISTORY
 static void apply_gravity(int16_t *entry, const int bonus) {
@@ -25,7 +23,7 @@ void update_piece_to_history(const Position *pos, const move_t move, int bonus)
   const int to = move & 0x3F;
   const int piece = pos->board[from];
 
-  apply_gravity(&piece_to_history[piece][to], bonus);
+  apply_gravity(&thread_hist->piece_to_history[piece][to], bonus);
 
 }
 
@@ -52,7 +50,7 @@ void update_capture_history(const Position *pos, const move_t move, int bonus) {
   int victim = pos->board[to];
   victim = (victim == EMPTY) ? PAWN : victim % 6;  // ep/promo -> pawn
 
-  apply_gravity(&capture_history[piece][to][victim], bonus);
+  apply_gravity(&thread_hist->capture_history[piece][to][victim], bonus);
 
 }
 
@@ -10,25 +10,29 @@
 #define MAX_HISTORY 32766
 #define KILLER 32767
 
-extern int16_t piece_to_history[12][64];
-extern int16_t cont_history[12][64][12][64];  // [prev piece][prev to][piece][to]
-extern int16_t capture_history[12][64][6];  // [piece][to][captured type] (ep/promo capture -> pawn)
+typedef struct {
+  int16_t piece_to_history[12][64];
+  int16_t cont_history[12][64][12][64];  // [prev piece][prev to][piece][to]
+  int16_t capture_history[12][64][6];  // [piece][to][captured type] (ep/promo capture -> pawn)
+  move_t counter_moves[12][64];
+} History;
+
+extern _Thread_local History *thread_hist;  // shared by smp threads unless the thread owns one
 
 inline void clear_piece_to_history(void) {
-  memset(piece_to_history, 0, sizeof(piece_to_history));
+  memset(thread_hist->piece_to_history, 0, sizeof(thread_hist->piece_to_history));
 }
 
 inline void clear_cont_history(void) {
-  memset(cont_history, 0, sizeof(cont_history));
+  memset(thread_hist->cont_history, 0, sizeof(thread_hist->cont_history));
 }
 
 inline void clear_capture_history(void) {
-  memset(capture_history, 0, sizeof(capture_history));
+  memset(thread_hist->capture_history, 0, sizeof(thread_hist->capture_history));
 }
 
-extern move_t counter_moves[12][64];
 inline void clear_counter_moves(void) {
-  memset(counter_moves, 0, sizeof(counter_moves));
+  memset(thread_hist->counter_moves, 0, sizeof(thread_hist->counter_moves));
 }
 
 void update_piece_to_history(const Position *pos, const move_t move, int bonus);
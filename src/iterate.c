@@ -5,6 +5,7 @@
 #include "pos.h"
 #include "movegen.h"
 #include "history.h"
+#include "stats.h"
 
 #define COUNTERMOVE 32766
 
@@ -56,18 +57,54 @@ static move_t get_next_sorted_move(Node *const node) {
 
 }
 
-static void rank_quiets(Node *node) {
+static const int32_t mvv_augment[6] = {0, 4800, 4800, 9600, 19200, 0};  // P,N,B,R,Q,-
+
+static inline int32_t quiet_rank(const Node *node, const move_t m) {
+
+  const int from = (m >> 6) & 0x3F;
+  const int to = m & 0x3F;
+  const int piece = node->pos.board[from];
+  const int16_t (*const piece_to_history)[64] = thread_hist->piece_to_history;
+  int16_t (*const cont)[64] = node->cont_entry;
+
+  // average keeps the sum below KILLER
+  return cont ? (piece_to_history[piece][to] + cont[piece][to]) / 2 : piece_to_history[piece][to];
+
+}
+
+static inline int32_t noisy_rank(const Node *node, const move_t m) {
 
   const uint8_t *board = node->pos.board;
+  const int from = (m >> 6) & 0x3F;
+  const int to = m & 0x3F;
+
+  if (m & MOVE_FLAG_CAPTURE) {
+
+    const int piece = board[from];
+    int victim = board[to];
+    victim = (victim == EMPTY) ? PAWN : victim % 6;  // ep -> pawn
+
+    // mvv + lva tiebreak + capture history
+    return 64000 + mvv_augment[victim] + (5 - piece % 6) + thread_hist->capture_history[piece][to][victim];
+
+  }
+
+  // non-capture promotion
+  const int promo_piece = (m >> 12) & 0x7;
+  return 64000 + mvv_augment[promo_piece];
+
+}
+
+static void rank_quiets(Node *node) {
+
   const move_t *moves = node->moves;
   const move_t killer = node->killer;
   int32_t *ranks = node->ranks;
-  int16_t (*const cont)[64] = node->cont_entry;
   const int n = node->num_moves;
 
   move_t countermove = 0;
   if (node->prev_piece != EMPTY) {
-    countermove = counter_moves[node->prev_piece][node->prev_to];
+    countermove = thread_hist->counter_moves[node->prev_piece][node->prev_to];
   }
 
   for (int i=0; i < n; i++) {
@@ -81,52 +118,68 @@ static void rank_quiets(Node *node) {
       ranks[i] = COUNTERMOVE;
     }
     else {
-
-      const int from = (m >> 6) & 0x3F;
-      const int to = m & 0x3F;
-      const int piece = board[from];
-
-      // average keeps the sum below KILLER
-      ranks[i] = cont ? (piece_to_history[piece][to] + cont[piece][to]) / 2 : piece_to_history[piece][to];
+      ranks[i] = quiet_rank(node, m);
     }
 
   }
 }
 
-static const int32_t mvv_augment[6] = {0, 4800, 4800, 9600, 19200, 0};  // P,N,B,R,Q,-
-
 static void rank_noisy(Node *node) {
 
-  const uint8_t *board = node->pos.board;
   const move_t *moves = node->moves;
   int32_t *ranks = node->ranks;
   const int n = node->num_moves;
 
+  for (int i=0; i < n; i++)
+    ranks[i] = noisy_rank(node, moves[i]);
+
+}
+
+// captures and promotions ahead of the killer, then quiets by history
+static void rank_evasions(Node *node) {
+
+  const move_t *moves = node->moves;
+  const move_t killer = node->killer;
+  int32_t *ranks = node->ranks;
+  const int n = node->num_moves;
+
   for (int i=0; i < n; i++) {
 
     const move_t m = moves[i];
-    const int from = (m >> 6) & 0x3F;
-    const int to = m & 0x3F;
 
-    if (m & MOVE_FLAG_CAPTURE) {
+    if (m & (MOVE_FLAG_CAPTURE | MOVE_FLAG_PROMOTE))
+      ranks[i] = noisy_rank(node, m);
+    else if (m == killer)
+      ranks[i] = KILLER;
+    else
+      ranks[i] = quiet_rank(node, m);
 
-      const int piece = board[from];
-      int victim = board[to];
-      victim = (victim == EMPTY) ? PAWN : victim % 6;  // ep -> pawn
+  }
+}
 
-      // mvv + lva tiebreak + capture history
-      ranks[i] = 64000 + mvv_augment[victim] + (5 - piece % 6) + capture_history[piece][to][victim];
+// in check every evasion is generated at once (stage 5), in both search and
+// qsearch
+static move_t get_next_evasion(Node *node) {
 
-    }
-    else {
+  if (node->stage != 5) {
 
-      // non-capture promotion
-      const int promo_piece = (m >> 12) & 0x7;
-      ranks[i] = 64000 + mvv_augment[promo_piece];
+    node->stage = 5;
+    node->num_moves = 0;
+    node->next_move = 0;
 
-    }
+    gen_evasions(node);
+    STAT_INC(evasion_gens);
+    STAT_ADD(evasion_moves, node->num_moves);
+    remove_tt_move(node);
+    rank_evasions(node);
 
   }
+
+  if (node->next_move < node->num_moves)
+    return get_next_sorted_move(node);
+
+  return 0;
+
 }
 
 void init_next_search_move(Node *node, const int in_check, const move_t tt_move) {
@@ -147,8 +200,10 @@ move_t get_next_search_move(Node *node) {
       node->num_moves = 0;
       node->next_move = 0;
       
-      if (node->tt_move)
+      if (node->tt_move && is_legal_move(&node->pos, &node->legal, node->tt_move)) {
+        STAT_INC(tt_moves);
         return node->tt_move;
+      }
       
     }
 
@@ -156,11 +211,16 @@ move_t get_next_search_move(Node *node) {
 
     case 1: {
 
+      if (node->in_check)
+        return get_next_evasion(node);
+
       node->stage++;
       node->num_moves = 0;
       node->next_move = 0;
 
       gen_noisy(node);
+      STAT_INC(noisy_gens);
+      STAT_ADD(noisy_moves, node->num_moves);
       remove_tt_move(node);
       rank_noisy(node);
 
@@ -181,6 +241,8 @@ move_t get_next_search_move(Node *node) {
       node->next_move = 0;
 
       gen_quiets(node);
+      STAT_INC(quiet_gens);
+      STAT_ADD(quiet_moves, node->num_moves);
       remove_tt_move(node);
       rank_quiets(node);
       
@@ -200,6 +262,9 @@ move_t get_next_search_move(Node *node) {
       
     }
 
+    case 5:
+      return get_next_evasion(node);
+
     default:
       return 0;
 
@@ -224,8 +289,10 @@ move_t get_next_qsearch_move(Node *node) {
       node->num_moves = 0;
       node->next_move = 0;
       
-      if (node->tt_move)
+      if (node->tt_move && is_legal_move(&node->pos, &node->legal, node->tt_move)) {
+        STAT_INC(tt_moves);
         return node->tt_move;
+      }
       
     }
 
@@ -233,11 +300,16 @@ move_t get_next_qsearch_move(Node *node) {
 
     case 1: {
 
+      if (node->in_check)
+        return get_next_evasion(node);
+
       node->stage++;
       node->num_moves = 0;
       node->next_move = 0;
 
       gen_noisy(node);
+      STAT_INC(qs_noisy_gens);
+      STAT_ADD(qs_noisy_moves, node->num_moves);
       remove_tt_move(node);
       rank_noisy(node);
 
@@ -257,6 +329,9 @@ move_t get_next_qsearch_move(Node *node) {
       
     }
 
+    case 5:
+      return get_next_evasion(node);
+
     default:
       return 0;
 
@@ -24,6 +24,7 @@ int main(int argc, char *argv[]) {
   init_zob();
   init_lmr();
   init_line_masks();
+  clear_nodes();
 
   position(&nodes[0], "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR", "w", "KQkq", "-", 0, 0, NULL);
 
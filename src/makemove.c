@@ -3,15 +3,17 @@
 #include "nodes.h"
 #include "move.h"
 #include "types.h"
-#include "iterate.h"
+#include "movegen.h"
 #include "zobrist.h"
 #include "net.h"
+#include "makemove.h"
 
 #define MOVE_FLAGS_PROMOCAP (MOVE_FLAG_PROMOTE | MOVE_FLAG_CAPTURE) 
 
-void make_move(Node *node, const move_t move) {
+// the position update shared by make_move and make_move_pos; nd receives the
+// accumulator delta and is a dead local when only the position is wanted
+static inline void do_move(Position *pos, NetDeferred *nd, const move_t move) {
 
-  Position *pos = &node->pos;
   uint8_t *board = pos->board;
   uint64_t *all = pos->all;
   uint64_t *colour = pos->colour;
@@ -30,7 +32,7 @@ void make_move(Node *node, const move_t move) {
 
   pos->ep = 0;
 
-  uint8_t *nd_args = node->net_deferred.args;
+  uint8_t *nd_args = nd->args;
 
   if (flags & MOVE_FLAGS_EXTRA) {
 
@@ -42,7 +44,7 @@ void make_move(Node *node, const move_t move) {
       colour[stm] ^= move_bb;
       colour[opp] ^= to_bb;
       hash ^= zob_pieces[from_piece][to] ^ zob_pieces[to_piece][to];
-      node->net_deferred.type = NET_OP_CAPTURE;
+      nd->type = NET_OP_CAPTURE;
       nd_args[0] = from_piece;
       nd_args[1] = from;
       nd_args[2] = to_piece;
@@ -61,7 +63,7 @@ void make_move(Node *node, const move_t move) {
       colour[stm] ^= move_bb;
       colour[opp] ^= cap_bb;
       hash ^= zob_pieces[from_piece][to] ^ zob_pieces[cap_piece][cap_sq];
-      node->net_deferred.type = NET_OP_EP_CAPTURE;
+      nd->type = NET_OP_EP_CAPTURE;
       nd_args[0] = from_piece;
       nd_args[1] = from;
       nd_args[2] = to;
@@ -79,7 +81,7 @@ void make_move(Node *node, const move_t move) {
       colour[stm] ^= move_bb;
       colour[opp] ^= to_bb;
       hash ^= zob_pieces[to_piece][to] ^ zob_pieces[promo_piece][to];
-      node->net_deferred.type = NET_OP_PROMO_CAPTURE;
+      nd->type = NET_OP_PROMO_CAPTURE;
       nd_args[0] = from_piece;
       nd_args[1] = from;
       nd_args[2] = to;
@@ -95,7 +97,7 @@ void make_move(Node *node, const move_t move) {
       all[promo_piece] ^= to_bb;
       colour[stm] ^= move_bb;
       hash ^= zob_pieces[promo_piece][to];
-      node->net_deferred.type = NET_OP_PROMO_PUSH;
+      nd->type = NET_OP_PROMO_PUSH;
       nd_args[0] = from_piece;
       nd_args[1] = from;
       nd_args[2] = to;
@@ -127,7 +129,7 @@ void make_move(Node *node, const move_t move) {
       hash ^= zob_pieces[king_piece][from] ^ zob_pieces[king_piece][k_to] 
             ^ zob_pieces[rook_piece][to] ^ zob_pieces[rook_piece][r_to];
 
-      node->net_deferred.type = NET_OP_CASTLE;
+      nd->type = NET_OP_CASTLE;
       nd_args[0] = king_piece;
       nd_args[1] = from;
       nd_args[2] = k_to;
@@ -147,7 +149,7 @@ void make_move(Node *node, const move_t move) {
       const uint64_t adj = ((to_bb & NOT_A_FILE) >> 1) | ((to_bb & NOT_H_FILE) << 1);
       if (all[opp_pawn] & adj)
         pos->ep = (from + to) >> 1;
-      node->net_deferred.type = NET_OP_MOVE;
+      nd->type = NET_OP_MOVE;
       nd_args[0] = from_piece;
       nd_args[1] = from;
       nd_args[2] = to;
@@ -162,7 +164,7 @@ void make_move(Node *node, const move_t move) {
     all[from_piece] ^= move_bb;
     colour[stm] ^= move_bb;
     hash ^= zob_pieces[from_piece][to];
-    node->net_deferred.type = NET_OP_MOVE;
+    nd->type = NET_OP_MOVE;
     nd_args[0] = from_piece;
     nd_args[1] = from;
     nd_args[2] = to;
@@ -187,28 +189,151 @@ void make_move(Node *node, const move_t move) {
 
 }
 
-void play_move(Node *node, char *uci_move) {
+void make_move(Node *node, const move_t move) {
 
-  char buf[6];
+  do_move(&node->pos, &node->net_deferred, move);
 
-  Position *pos = &node->pos;
-  const int stm = pos->stm;
-  const int opp = stm ^ 1;
-  const int stm_king_sq = piece_index(KING, stm);
-  const int in_check = is_attacked(pos, bsf(pos->all[stm_king_sq]), opp);
-  move_t move ;
+}
+
+void make_move_pos(Position *pos, const move_t move) {
+
+  NetDeferred nd;
+  do_move(pos, &nd, move);
+
+}
+
+// make in place, keeping what unmake_move needs to take the move back
+void make_move_undo(Position *pos, const move_t move, Undo *u) {
+
+  const int to = move & 0x3F;
+
+  u->hash = pos->hash;
+  u->rights = pos->rights;
+  u->ep = pos->ep;
+  u->hmc = pos->hmc;
+  u->captured = (move & MOVE_FLAG_EPCAPTURE) ? pos->board[to + (pos->stm ? 8 : -8)] : pos->board[to];
 
-  init_next_search_move(node, in_check, 0);
+  NetDeferred nd;
+  do_move(pos, &nd, move);
 
-  while ((move = get_next_search_move(node))) {
+}
+
+// the reverse of do_move, branch for branch
+void unmake_move(Position *pos, const move_t move, const Undo *u) {
+
+  uint8_t *board = pos->board;
+  uint64_t *all = pos->all;
+  uint64_t *colour = pos->colour;
+  const int opp = pos->stm;
+  const int stm = opp ^ 1;
+  const int flags = move & 0xFFF000;
+  const int from = (move >> 6) & 0x3F;
+  const int to = move & 0x3F;
+  const int to_piece = board[to];
+  const int captured = u->captured;
+  const uint64_t from_bb = 1ULL << from;
+  const uint64_t to_bb = 1ULL << to;
+  const uint64_t move_bb = from_bb ^ to_bb;
+
+  if ((flags & MOVE_FLAGS_EXTRA) == MOVE_FLAG_CAPTURE) {
+    board[from] = to_piece;
+    board[to] = captured;
+    all[to_piece] ^= move_bb;
+    all[captured] ^= to_bb;
+    colour[stm] ^= move_bb;
+    colour[opp] ^= to_bb;
+  }
+
+  else if (flags & MOVE_FLAG_EPCAPTURE) {
+    const int cap_sq = to + (stm ? 8 : -8);
+    const uint64_t cap_bb = 1ULL << cap_sq;
+    board[from] = to_piece;
+    board[to] = EMPTY;
+    board[cap_sq] = captured;
+    all[to_piece] ^= move_bb;
+    all[captured] ^= cap_bb;
+    colour[stm] ^= move_bb;
+    colour[opp] ^= cap_bb;
+  }
+
+  else if ((flags & MOVE_FLAGS_PROMOCAP) == MOVE_FLAGS_PROMOCAP) {
+    const int pawn = piece_index(PAWN, stm);
+    board[from] = pawn;
+    board[to] = captured;
+    all[pawn] ^= from_bb;
+    all[to_piece] ^= to_bb;
+    all[captured] ^= to_bb;
+    colour[stm] ^= move_bb;
+    colour[opp] ^= to_bb;
+  }
+
+  else if (flags & MOVE_FLAG_PROMOTE) {
+    const int pawn = piece_index(PAWN, stm);
+    board[from] = pawn;
+    board[to] = EMPTY;
+    all[pawn] ^= from_bb;
+    all[to_piece] ^= to_bb;
+    colour[stm] ^= move_bb;
+  }
+
+  else if (flags & MOVE_FLAG_CASTLE) {
+    const int k_to = (to > from) ? G1 + (stm * 56) : C1 + (stm * 56);
+    const int r_to = (to > from) ? F1 + (stm * 56) : D1 + (stm * 56);
+    const int king_piece = board[k_to];
+    const int rook_piece = board[r_to];
+
+    // lift both before putting them back, the squares can overlap in 960
+    board[k_to] = EMPTY;
+    board[r_to] = EMPTY;
+    all[king_piece] ^= (1ULL << k_to);
+    all[rook_piece] ^= (1ULL << r_to);
+    colour[stm] ^= ((1ULL << k_to) | (1ULL << r_to));
+
+    board[from] = king_piece;
+    board[to] = rook_piece;
+    all[king_piece] ^= from_bb;
+    all[rook_piece] ^= to_bb;
+    colour[stm] ^= move_bb;
+  }
+
+  else {
+    // quiet move or pawn2
+    board[from] = to_piece;
+    board[to] = EMPTY;
+    all[to_piece] ^= move_bb;
+    colour[stm] ^= move_bb;
+  }
+
+  pos->occupied = colour[WHITE] | colour[BLACK];
+  pos->stm = stm;
+  pos->hash = u->hash;
+  pos->rights = u->rights;
+  pos->ep = u->ep;
+  pos->hmc = u->hmc;
+
+}
+
+// make a known legal move on a node and bring its accumulators up to date
+void apply_move(Node *node, const move_t move) {
+
+  make_move(node, move);
+  // scratch source so update_accs() src/dest don't alias
+  int16_t scratch[2][NET_H1_SIZE];
+  memcpy(scratch, node->accs, sizeof scratch);
+  update_accs(node, scratch);
+
+}
+
+void play_move(Node *node, char *uci_move) {
+
+  char buf[6];
+  move_t legal[MAX_MOVES];
+  const int n = gen_legal_moves(&node->pos, legal);
 
-    format_move(move, buf);
+  for (int i=0; i < n; i++) {
+    format_move(legal[i], buf);
     if (!strcmp(uci_move, buf)) {
-      make_move(node, move);
-      // scratch source so update_accs() src/dest don't alias
-      int16_t scratch[2][NET_H1_SIZE];
-      memcpy(scratch, node->accs, sizeof scratch);
-      update_accs(node, scratch);
+      apply_move(node, legal[i]);
       return;
     }
   }
@@ -5,7 +5,23 @@
 #include "move.h"
 
 void make_move(Node *node, const move_t move);
+void make_move_pos(Position *pos, const move_t move);
+void apply_move(Node *node, const move_t move);
 void play_move(Node *node, char *uci_move);
 void make_null_move(Position *pos);
 
+// what unmake_move cannot work out from the move and the position after it
+typedef struct {
+
+  uint64_t hash;
+  uint8_t captured;  // the captured piece, EMPTY if none
+  uint8_t rights;
+  uint8_t ep;
+  uint8_t hmc;
+
+} Undo;
+
+void make_move_undo(Position *pos, const move_t move, Undo *u);
+void unmake_move(Position *pos, const move_t move, const Undo *u);
+
 #endif
@@ -0,0 +1,86 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mapfile.h"
+
+#ifndef _WIN32
+  #include <fcntl.h>
+  #include <unistd.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+#endif
+
+// map the file (or read it where mmap is unavailable); 1 if it cannot be
+// read or is empty
+int map_file(MappedFile *mf, const char *path) {
+
+  memset(mf, 0, sizeof(MappedFile));
+
+#ifndef _WIN32
+
+  const int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return 1;
+
+  struct stat st;
+  if (fstat(fd, &st) || st.st_size <= 0) {
+    close(fd);
+    return 1;
+  }
+
+  void *p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if (p == MAP_FAILED)
+    return 1;
+
+  madvise(p, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+  mf->data = p;
+  mf->size = (size_t)st.st_size;
+  mf->mapped = 1;
+
+  return 0;
+
+#else
+
+  FILE *f = fopen(path, "rb");
+  if (!f)
+    return 1;
+
+  _fseeki64(f, 0, SEEK_END);
+  long long bytes = _ftelli64(f);
+  _fseeki64(f, 0, SEEK_SET);
+
+  unsigned char *p = bytes > 0 ? malloc((size_t)bytes) : NULL;
+  if (!p || fread(p, 1, (size_t)bytes, f) != (size_t)bytes) {
+    free(p);
+    fclose(f);
+    return 1;
+  }
+
+  fclose(f);
+
+  mf->data = p;
+  mf->size = (size_t)bytes;
+  mf->mapped = 0;
+
+  return 0;
+
+#endif
+
+}
+
+void unmap_file(MappedFile *mf) {
+
+#ifndef _WIN32
+  if (mf->mapped && mf->data)
+    munmap((void *)mf->data, mf->size);
+#endif
+
+  if (!mf->mapped)
+    free((void *)mf->data);
+
+  memset(mf, 0, sizeof(MappedFile));
+
+}
@@ -0,0 +1,16 @@
+#ifndef MAPFILE_H
+#define MAPFILE_H
+
+#include <stddef.h>
+
+// a whole file in memory, read only; mapped where the os allows it
+typedef struct {
+  const unsigned char *data;
+  size_t size;
+  int mapped;
+} MappedFile;
+
+int map_file(MappedFile *mf, const char *path);
+void unmap_file(MappedFile *mf);
+
+#endif
@@ -0,0 +1,521 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "microbench.h"
+#include "bench.h"
+#include "builtins.h"
+#include "nodes.h"
+#include "pos.h"
+#include "move.h"
+#include "movegen.h"
+#include "makemove.h"
+#include "see.h"
+#include "net.h"
+#include "bitboard.h"
+#include "profile.h"
+#include "go.h"
+#include "tt.h"
+#include "timecontrol.h"
+#include "trace.h"
+#include "uci.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+  #include <x86intrin.h>
+  #define MB_TSC() __rdtsc()
+#else
+  #define MB_TSC() 0ULL
+#endif
+
+#define MB_DEPTH 8        // bench search depth the stream is sampled from
+#define MB_SAMPLES 24     // search nodes kept per bench position
+#define MB_HASH_MB 16
+#define MB_DEFAULT_MS 250
+
+// one legal move from a stream position, with the child it leads to
+typedef struct {
+
+  int parent;
+  move_t move;
+  Position child;
+  NetDeferred nd;
+
+} MbMove;
+
+typedef struct {
+
+  void *accs_mem;
+  Node *pos_nodes;  // stream positions with their accumulators built
+  LegalInfo *legal;
+  int num_pos;
+  MbMove *moves;
+  int num_moves;
+
+} MbStream;
+
+typedef struct {
+
+  const char *name;
+  uint64_t (*run)(const MbStream *s);
+
+} MbComponent;
+
+static volatile uint64_t mb_sink;
+
+static uint64_t mb_rand(uint64_t *state) {
+
+  *state = *state * 6364136223846793005ULL + 1442695040888963407ULL;
+  return *state >> 33;
+
+}
+
+// reservoir of search nodes for the bench position being searched
+static Position mb_samples[MB_SAMPLES];
+static uint64_t mb_seen;
+static uint64_t mb_seed;
+
+// every node the search enters is equally likely to end up in the reservoir
+static void mb_sample(const int ply, const int depth) {
+
+  (void)depth;
+
+  const uint64_t n = mb_seen++;
+  const uint64_t j = n < MB_SAMPLES ? n : mb_rand(&mb_seed) % (n + 1);
+
+  if (j < MB_SAMPLES)
+    mb_samples[j] = nodes[ply].pos;
+
+}
+
+// search every bench position and keep a fixed random sample of the nodes
+// entered plus all their legal moves, so the components see the positions
+// the search does rather than positions from random play
+static int mb_record(MbStream *s) {
+
+  const int max_pos = BENCH_FENS * MB_SAMPLES;
+  int cap = max_pos * 32;
+  move_t legal[MAX_MOVES];
+
+  // accs are 64 byte aligned and aligned_alloc is missing on windows
+  s->accs_mem = malloc(max_pos * sizeof(NodeAccs) + 64);
+  s->pos_nodes = malloc(max_pos * sizeof(Node));
+  s->legal = malloc(max_pos * sizeof(LegalInfo));
+  s->moves = malloc(cap * sizeof(MbMove));
+  s->num_pos = 0;
+  s->num_moves = 0;
+
+  if (!s->accs_mem || !s->pos_nodes || !s->legal || !s->moves)
+    return 1;
+
+  if (go_private_init(MB_HASH_MB))
+    return 1;
+
+  NodeAccs *accs = (NodeAccs *)(((uintptr_t)s->accs_mem + 63) & ~(uintptr_t)63);
+  const int saved_threads = num_threads;
+  int failed = 0;
+
+  num_threads = 1;
+  mb_seed = 1;
+  trace_sample(mb_sample);
+
+  for (int i=0; i < BENCH_FENS && !failed; i++) {
+
+    new_game();
+    bench_position(i);
+    init_tc(0, 0, 0, 0, 0, 0, MB_DEPTH, 0);
+
+    mb_seen = 0;
+    go(1);
+
+    const int samples = mb_seen < MB_SAMPLES ? (int)mb_seen : MB_SAMPLES;
+
+    for (int k=0; k < samples; k++) {
+
+      const Position pos = mb_samples[k];
+      const int n = gen_legal_moves(&pos, legal);
+
+      if (!n)
+        continue;
+
+      if (s->num_moves + n > cap) {
+        cap *= 2;
+        MbMove *grown = realloc(s->moves, cap * sizeof(MbMove));
+        if (!grown) {
+          failed = 1;
+          break;
+        }
+        s->moves = grown;
+      }
+
+      const int idx = s->num_pos++;
+      Node *node = &s->pos_nodes[idx];
+
+      node->pos = pos;
+      node->accs = accs[idx].accs;
+      net_slow_rebuild_accs(node);
+      legal_info(&pos, &s->legal[idx]);
+
+      for (int m=0; m < n; m++) {
+        MbMove *mm = &s->moves[s->num_moves++];
+        nodes[1].pos = pos;
+        make_move(&nodes[1], legal[m]);
+        mm->parent = idx;
+        mm->move = legal[m];
+        mm->child = nodes[1].pos;
+        mm->nd = nodes[1].net_deferred;
+      }
+
+    }
+
+  }
+
+  trace_sample(NULL);
+  num_threads = saved_threads;
+  go_private_free();
+
+  return failed || !s->num_moves;
+
+}
+
+static void mb_free(MbStream *s) {
+
+  free(s->accs_mem);
+  free(s->pos_nodes);
+  free(s->legal);
+  free(s->moves);
+
+}
+
+static uint64_t mb_make_move(const MbStream *s) {
+
+  Node *node = &nodes[0];
+  uint64_t sink = 0;
+
+  for (int i=0; i < s->num_moves; i++) {
+    const MbMove *mm = &s->moves[i];
+    node->pos = s->pos_nodes[mm->parent].pos;
+    make_move(node, mm->move);
+    sink += node->pos.hash;
+  }
+
+  mb_sink += sink;
+  return s->num_moves;
+
+}
+
+// make and take back each move in place; the parent is copied once for all
+// its moves, as a search or perft using unmake would not copy at all
+static uint64_t mb_make_unmake(const MbStream *s) {
+
+  Position pos;
+  int parent = -1;
+  uint64_t sink = 0;
+
+  for (int i=0; i < s->num_moves; i++) {
+    const MbMove *mm = &s->moves[i];
+    Undo u;
+    if (mm->parent != parent) {
+      parent = mm->parent;
+      pos = s->pos_nodes[parent].pos;
+    }
+    make_move_undo(&pos, mm->move, &u);
+    sink += pos.hash;
+    unmake_move(&pos, mm->move, &u);
+  }
+
+  mb_sink += sink;
+  return s->num_moves;
+
+}
+
+static uint64_t mb_gen_noisy(const MbStream *s) {
+
+  Node *node = &nodes[0];
+  uint64_t sink = 0;
+
+  for (int i=0; i < s->num_pos; i++) {
+    node->pos = s->pos_nodes[i].pos;
+    node->legal = s->legal[i];
+    node->num_moves = 0;
+    gen_noisy(node);
+    sink += node->num_moves;
+  }
+
+  mb_sink += sink;
+  return s->num_pos;
+
+}
+
+static uint64_t mb_gen_quiets(const MbStream *s) {
+
+  Node *node = &nodes[0];
+  uint64_t sink = 0;
+
+  for (int i=0; i < s->num_pos; i++) {
+    node->pos = s->pos_nodes[i].pos;
+    node->legal = s->legal[i];
+    node->num_moves = 0;
+    gen_quiets(node);
+    sink += node->num_moves;
+  }
+
+  mb_sink += sink;
+  return s->num_pos;
+
+}
+
+static uint64_t mb_legal_info(const MbStream *s) {
+
+  LegalInfo li;
+  uint64_t sink = 0;
+
+  for (int i=0; i < s->num_pos; i++) {
+    legal_info(&s->pos_nodes[i].pos, &li);
+    sink += li.checkers ^ li.pinned;
+  }
+
+  mb_sink += sink;
+  return s->num_pos;
+
+}
+
+// check_info once per position, as a search would, then every move tested
+static uint64_t mb_gives_check(const MbStream *s) {
+
+  CheckInfo ci;
+  int parent = -1;
+  uint64_t sink = 0;
+
+  for (int i=0; i < s->num_moves; i++) {
+    const MbMove *mm = &s->moves[i];
+    const Position *pos = &s->pos_nodes[mm->parent].pos;
+    if (mm->parent != parent) {
+      parent = mm->parent;
+      check_info(pos, &ci);
+    }
+    sink += gives_check(pos, &ci, mm->move);
+  }
+
+  mb_sink += sink;
+  return s->num_moves;
+
+}
+
+// every square against the side not to move, as legality and pruning ask
+static uint64_t mb_is_attacked(const MbStream *s) {
+
+  uint64_t sink = 0;
+
+  for (int i=0; i < s->num_pos; i++) {
+    const Position *pos = &s->pos_nodes[i].pos;
+    for (int sq=0; sq < 64; sq++)
+      sink += is_attacked(pos, sq, pos->stm ^ 1);
+  }
+
+  mb_sink += sink;
+  return (uint64_t)s->num_pos * 64;
+
+}
+
+// bishop and rook attacks from every square over each position's pieces;
+// this walks all of the slider tables
+static uint64_t mb_sliders(const MbStream *s) {
+
+  uint64_t sink = 0;
+
+  for (int i=0; i < s->num_pos; i++) {
+    const uint64_t occ = s->pos_nodes[i].pos.occupied;
+    for (int sq=0; sq < 64; sq++)
+      sink ^= bishop_attacks_bb(sq, occ) ^ rook_attacks_bb(sq, occ);
+  }
+
+  mb_sink += sink;
+  return (uint64_t)s->num_pos * 64;
+
+}
+
+static uint64_t mb_see_ge(const MbStream *s) {
+
+  uint64_t sink = 0;
+
+  for (int i=0; i < s->num_moves; i++) {
+    const MbMove *mm = &s->moves[i];
+    sink += see_ge(&s->pos_nodes[mm->parent].pos, mm->move, 0);
+  }
+
+  mb_sink += sink;
+  return s->num_moves;
+
+}
+
+static uint64_t mb_update_accs(const MbStream *s) {
+
+  Node *node = &nodes[1];
+  uint64_t sink = 0;
+
+  for (int i=0; i < s->num_moves; i++) {
+    const MbMove *mm = &s->moves[i];
+    node->pos = mm->child;
+    node->net_deferred = mm->nd;
+    update_accs(node, s->pos_nodes[mm->parent].accs);
+    sink += node->accs[0][0];
+  }
+
+  mb_sink += sink;
+  return s->num_moves;
+
+}
+
+// both perspectives through the finny cache, walking the stream in order
+static uint64_t mb_refresh_acc(const MbStream *s) {
+
+  Node *node = &nodes[0];
+  uint64_t sink = 0;
+
+  for (int i=0; i < s->num_pos; i++) {
+    node->pos = s->pos_nodes[i].pos;
+    net_refresh_accs(node);
+    sink += node->accs[1][0];
+  }
+
+  mb_sink += sink;
+  return s->num_pos;
+
+}
+
+static uint64_t mb_net_eval(const MbStream *s) {
+
+  uint64_t sink = 0;
+
+  for (int i=0; i < s->num_pos; i++)
+    sink += net_eval(&s->pos_nodes[i]);
+
+  mb_sink += sink;
+  return s->num_pos;
+
+}
+
+static const MbComponent mb_components[] = {
+
+  {"make_move",       mb_make_move},
+  {"make_unmake",     mb_make_unmake},
+  {"gen_noisy",       mb_gen_noisy},
+  {"gen_quiets",      mb_gen_quiets},
+  {"legal_info",      mb_legal_info},
+  {"gives_check",     mb_gives_check},
+  {"is_attacked",     mb_is_attacked},
+  {"sliders",         mb_sliders},
+  {"see_ge",          mb_see_ge},
+  {"update_accs",     mb_update_accs},
+  {"net_refresh_acc", mb_refresh_acc},
+  {"net_eval",        mb_net_eval}
+
+};
+
+// time whole passes over the stream until ms have elapsed, after one
+// untimed warmup pass; the best pass is the least disturbed by the host
+static void mb_time(const MbComponent *c, const MbStream *s, const int ms, ProfSet *prof, ProfCounts *all) {
+
+  uint64_t ops = 0, total_us = 0, total_tsc = 0;
+  double best_ns = 1e18;
+  ProfCounts counts = {0};
+
+  c->run(s);
+
+  if (prof)
+    prof_start(prof);
+
+  while (total_us < (uint64_t)ms * 1000) {
+
+    const uint64_t start_tsc = MB_TSC();
+    const uint64_t start_us = time_us();
+    const uint64_t n = c->run(s);
+    const uint64_t us = time_us() - start_us;
+
+    total_tsc += MB_TSC() - start_tsc;
+    total_us += us;
+    ops += n;
+
+    if (us * 1000.0 / n < best_ns)
+      best_ns = us * 1000.0 / n;
+
+  }
+
+  if (prof)
+    prof_stop(prof, &counts);
+
+  const double ns = (double)total_us * 1000.0 / (double)ops;
+
+  printf("%-16s %12llu %9.2f %9.2f %11.0f %9.1f",
+    c->name,
+    (unsigned long long)ops,
+    ns,
+    best_ns,
+    1e9 / ns,
+    (double)total_tsc / (double)ops);
+
+  if (prof) {
+    prof_print(&counts, (double)ops);
+    prof_add(all, &counts);
+  }
+
+  printf("\n");
+
+}
+
+// with profile set each component also reports ipc and misses per op
+
+void microbench(const char *component, int ms, int profile) {
+
+  MbStream s;
+  ProfSet prof;
+  ProfCounts all = {0};
+  const int num = sizeof(mb_components) / sizeof(mb_components[0]);
+  int found = !component;
+
+  for (int i=0; i < num && !found; i++)
+    found = !strcmp(component, mb_components[i].name);
+
+  if (!found) {
+    printf("error: unknown component %s\n", component);
+    return;
+  }
+
+  if (ms < 1)
+    ms = MB_DEFAULT_MS;
+
+  if (profile && prof_open(&prof)) {
+    printf("error: perf_event_open failed, check kernel.perf_event_paranoid\n");
+    return;
+  }
+
+  memset(&s, 0, sizeof(s));
+
+  if (mb_record(&s)) {
+    printf("error: cannot allocate the microbench stream\n");
+    mb_free(&s);
+    if (profile)
+      prof_close(&prof);
+    return;
+  }
+
+  net_init_thread();
+
+  printf("microbench: %d positions %d moves %d ms per component\n", s.num_pos, s.num_moves, ms);
+  printf("%-16s %12s %9s %9s %11s %9s", "component", "ops", "ns/op", "best ns", "ops/s", "tsc/op");
+  if (profile)
+    prof_header();
+  printf("\n");
+
+  for (int i=0; i < num; i++) {
+    if (!component || !strcmp(component, mb_components[i].name))
+      mb_time(&mb_components[i], &s, ms, profile ? &prof : NULL, &all);
+  }
+
+  mb_free(&s);
+
+  if (profile) {
+    prof_coverage(&all);
+    prof_close(&prof);
+  }
+
+}
@@ -0,0 +1,6 @@
+#ifndef MICROBENCH_H
+#define MICROBENCH_H
+
+void microbench(const char *component, int ms, int profile);
+
+#endif
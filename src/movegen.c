@@ -7,12 +7,10 @@
 #include "movegen.h"
 #include "bitboard.h"
 
-static void gen_pawns_white_quiets(Node *node, const uint64_t targets) {
+static int gen_pawns_white_quiets(const Position *pos, move_t *m, const uint64_t targets) {
 
-  const Position *pos = &node->pos;
   const uint64_t pawns = pos->all[WPAWN];
   const uint64_t occupied = pos->occupied;
-  move_t *m = node->moves + node->num_moves;
   int n = 0;
 
   // push 1
@@ -34,16 +32,14 @@ static void gen_pawns_white_quiets(Node *node, const uint64_t targets) {
     m[n++] = encode_move(to - 16, to, MOVE_FLAG_PAWN2);
   }
 
-  node->num_moves += n;
+  return n;
 
 }
 
-static void gen_pawns_white_push_promos(Node *node, const uint64_t targets) {
+static int gen_pawns_white_push_promos(const Position *pos, move_t *m, const uint64_t targets) {
 
-  const Position *pos = &node->pos;
   const uint64_t pawns = pos->all[WPAWN];
   const uint64_t occupied = pos->occupied;
-  move_t *m = node->moves + node->num_moves;
   int n = 0;
 
   uint64_t promo = ((pawns << 8) & ~occupied) & RANK_8 & targets;
@@ -60,15 +56,13 @@ static void gen_pawns_white_push_promos(Node *node, const uint64_t targets) {
 
   }
 
-  node->num_moves += n;
+  return n;
 
 }
 
-static void gen_pawns_white_captures(Node *node, const uint64_t targets) {
+static int gen_pawns_white_captures(const Position *pos, move_t *m, const uint64_t targets) {
 
-  const Position *pos = &node->pos;
   const uint64_t pawns = pos->all[WPAWN];
-  move_t *m = node->moves + node->num_moves;
   int n = 0;
 
   const uint64_t left = ((pawns << 7) & NOT_H_FILE) & targets;
@@ -125,16 +119,14 @@ static void gen_pawns_white_captures(Node *node, const uint64_t targets) {
   
   }
   
-  node->num_moves += n;
+  return n;
 
 }
 
-static void gen_pawns_black_quiets(Node *node, const uint64_t targets) {
+static int gen_pawns_black_quiets(const Position *pos, move_t *m, const uint64_t targets) {
 
-  const Position *pos = &node->pos;
   const uint64_t pawns = pos->all[BPAWN];
   const uint64_t occupied = pos->occupied;
-  move_t *m = node->moves + node->num_moves;
   int n = 0;
 
   const uint64_t one = (pawns >> 8) & ~occupied;
@@ -152,16 +144,14 @@ static void gen_pawns_black_quiets(Node *node, const uint64_t targets) {
     m[n++] = encode_move(to + 16, to, MOVE_FLAG_PAWN2);
   }
 
-  node->num_moves += n;
+  return n;
 
 }
 
-static void gen_pawns_black_push_promos(Node *node, const uint64_t targets) {
+static int gen_pawns_black_push_promos(const Position *pos, move_t *m, const uint64_t targets) {
 
-  const Position *pos = &node->pos;
   const uint64_t pawns = pos->all[BPAWN];
   const uint64_t occupied = pos->occupied;
-  move_t *m = node->moves + node->num_moves;
   int n = 0;
 
   uint64_t promo = ((pawns >> 8) & ~occupied) & RANK_1 & targets;
@@ -178,15 +168,13 @@ static void gen_pawns_black_push_promos(Node *node, const uint64_t targets) {
 
   }
 
-  node->num_moves += n;
+  return n;
 
 }
 
-static void gen_pawns_black_captures(Node *node, const uint64_t targets) {
+static int gen_pawns_black_captures(const Position *pos, move_t *m, const uint64_t targets) {
 
-  const Position *pos = &node->pos;
   const uint64_t pawns = pos->all[BPAWN];
-  move_t *m = node->moves + node->num_moves;
   int n = 0;
 
   const uint64_t left = ((pawns >> 9) & NOT_H_FILE) & targets;
@@ -243,38 +231,34 @@ static void gen_pawns_black_captures(Node *node, const uint64_t targets) {
 
   }
 
-  node->num_moves += n;
+  return n;
 
 }
 
-static inline void gen_pawns_quiets(Node *const node, const uint64_t targets) {
-  if (node->pos.stm == WHITE)
-    gen_pawns_white_quiets(node, targets);
+static inline int gen_pawns_quiets(const Position *const pos, move_t *m, const uint64_t targets) {
+  if (pos->stm == WHITE)
+    return gen_pawns_white_quiets(pos, m, targets);
   else
-    gen_pawns_black_quiets(node, targets);
+    return gen_pawns_black_quiets(pos, m, targets);
 }
 
-static inline void gen_pawns_captures(Node *const node, const uint64_t targets) {
-  if (node->pos.stm == WHITE)
-    gen_pawns_white_captures(node, targets);
+static inline int gen_pawns_captures(const Position *const pos, move_t *m, const uint64_t targets) {
+  if (pos->stm == WHITE)
+    return gen_pawns_white_captures(pos, m, targets);
   else
-    gen_pawns_black_captures(node, targets);
+    return gen_pawns_black_captures(pos, m, targets);
 }
 
-static inline void gen_pawns_push_promos(Node *const node, const uint64_t targets) {
-  if (node->pos.stm == WHITE)
-    gen_pawns_white_push_promos(node, targets);
+static inline int gen_pawns_push_promos(const Position *const pos, move_t *m, const uint64_t targets) {
+  if (pos->stm == WHITE)
+    return gen_pawns_white_push_promos(pos, m, targets);
   else
-    gen_pawns_black_push_promos(node, targets);
+    return gen_pawns_black_push_promos(pos, m, targets);
 }
 
-static void gen_jumpers(Node *node, const uint64_t *attack_table, const int piece, const uint64_t targets, const uint32_t flags) {
+static int gen_jumpers(move_t *m, const uint64_t *attack_table, uint64_t bb, const uint64_t targets, const uint32_t flags) {
 
-  const Position *pos = &node->pos;
-  const int stm = pos->stm;
-  move_t *m = node->moves + node->num_moves;
   int n = 0;
-  uint64_t bb = pos->all[piece_index(piece, stm)];
 
   while (bb) {
 
@@ -288,26 +272,20 @@ static void gen_jumpers(Node *node, const uint64_t *attack_table, const int piec
 
   }
 
-  node->num_moves += n;
+  return n;
 
 }
 
-static void gen_sliders(Node *node, const Attack *attack_table, const int piece, const uint64_t targets, const uint32_t flags) {
+static int gen_sliders(const Position *pos, move_t *m, const Attack *attack_table, uint64_t bb, const uint64_t targets, const uint32_t flags) {
 
-  const Position *pos = &node->pos;
-  const int stm = pos->stm;
   const uint64_t occ = pos->occupied;
-  move_t *m  = node->moves + node->num_moves;
   int n = 0;
-  uint64_t bb = pos->all[piece_index(piece, stm)];
 
   while (bb) {
 
     const int from  = bsf(bb); bb &= bb - 1;
     const Attack *a = &attack_table[from];
-    const uint64_t blockers = occ & a->mask;
-    const int index = magic_index(blockers, a->magic, a->shift);
-    uint64_t attacks = a->attacks[index] & targets;
+    uint64_t attacks = slider_attacks(a, occ) & targets;
 
     while (attacks) {
       const int to = bsf(attacks); attacks &= attacks - 1;
@@ -316,20 +294,64 @@ static void gen_sliders(Node *node, const Attack *attack_table, const int piece,
 
   }
 
-  node->num_moves += n;
+  return n;
+
+}
+
+// pinned sliders stay on their pin ray; kept apart from gen_sliders so the
+// common case pays nothing for them
+static int gen_pinned_sliders(const Position *pos, const LegalInfo *li, move_t *m, const uint64_t targets, const uint32_t flags) {
+
+  const int stm = pos->stm;
+  const uint64_t *all = pos->all;
+  const uint64_t diag = li->pinned & (all[piece_index(BISHOP, stm)] | all[piece_index(QUEEN, stm)]);
+  const uint64_t orth = li->pinned & (all[piece_index(ROOK, stm)] | all[piece_index(QUEEN, stm)]);
+  int n = 0;
+
+  for (int i=0; i < 2; i++) {
+
+    uint64_t bb = i ? orth : diag;
+    const Attack *table = i ? rook_attacks : bishop_attacks;
+
+    while (bb) {
+      const int from = bsf(bb); bb &= bb - 1;
+      n += gen_sliders(pos, m + n, table, 1ULL << from, targets & line_bb[li->king_sq][from], flags);
+    }
+
+  }
+
+  return n;
 
 }
 
-static void gen_castling(Node *node) {
+// the king's own square is cleared so it cannot hide behind itself from a
+// slider it is stepping away from
+static int gen_king(const Position *pos, const LegalInfo *li, move_t *m, const uint64_t targets, const uint32_t flags) {
+
+  const int opp = pos->stm ^ 1;
+  const int from = li->king_sq;
+  const uint64_t occ = pos->occupied ^ (1ULL << from);
+  uint64_t attacks = king_attacks[from] & targets;
+  int n = 0;
+
+  while (attacks) {
+    const int to = bsf(attacks); attacks &= attacks - 1;
+    if (!attackers_to(pos, to, opp, occ))
+      m[n++] = encode_move(from, to, flags);
+  }
+
+  return n;
+
+}
+
+static int gen_castling(const Position *pos, move_t *m) {
 
-  const Position *pos = &node->pos;
   const int stm = pos->stm;
   const int opp = stm ^ 1;
   const uint8_t rights = pos->rights;
-  move_t *m = node->moves + node->num_moves;
   int n = 0;
 
-  if (!rights) return;
+  if (!rights) return 0;
 
   const int rank_offset = stm == WHITE ? 0 : 56;
   const int k_from = bsf(pos->all[piece_index(KING, stm)]);
@@ -360,13 +382,10 @@ static void gen_castling(Node *node) {
       int safe = 1;
       int step = (k_to > k_from) ? 1 : (k_to < k_from ? -1 : 0);
       
-      // King cannot be in check, pass through check, or land in check
-      if (step != 0) {
-        for (int sq = k_from; sq != k_to + step; sq += step) {
-          if (is_attacked(pos, sq, opp)) { safe = 0; break; }
-        }
-      } else {
-        if (is_attacked(pos, k_from, opp)) safe = 0;
+      // King cannot pass through check or land in check; it is not in check,
+      // castling is only generated then
+      for (int sq = k_from + step; step && sq != k_to + step; sq += step) {
+        if (is_attacked(pos, sq, opp)) { safe = 0; break; }
       }
 
       if (safe) m[n++] = encode_move(k_from, r_from, MOVE_FLAG_CASTLE);
@@ -397,73 +416,236 @@ static void gen_castling(Node *node) {
       int safe = 1;
       int step = (k_to > k_from) ? 1 : (k_to < k_from ? -1 : 0);
       
-      if (step != 0) {
-        for (int sq = k_from; sq != k_to + step; sq += step) {
-          if (is_attacked(pos, sq, opp)) { safe = 0; break; }
-        }
-      } else {
-         if (is_attacked(pos, k_from, opp)) safe = 0;
+      for (int sq = k_from + step; step && sq != k_to + step; sq += step) {
+        if (is_attacked(pos, sq, opp)) { safe = 0; break; }
       }
 
       if (safe) m[n++] = encode_move(k_from, r_from, MOVE_FLAG_CASTLE);
     }
   }
 
-  node->num_moves += n;
+  return n;
 }
 
-void gen_noisy(Node *node) {
+// moves from the evasion aware generators below are legal unless the king
+// walks into an attack, a pinned piece leaves its pin ray or an ep capture
+// uncovers the king; anything else (a tt move say) is checked in full
+int is_legal_move(const Position *pos, const LegalInfo *li, const move_t move) {
+
+  const int from = (move >> 6) & 0x3F;
+  const int to = move & 0x3F;
+  const int opp = pos->stm ^ 1;
+  const int king_sq = li->king_sq;
+  const uint64_t checkers = li->checkers;
+
+  if (from == king_sq) {
+
+    if (move & MOVE_FLAG_CASTLE) {
+
+      // gen_castling tests the squares crossed with the castling rook still
+      // in place, which can hide an attack on the king's last square (chess960)
+      const int k_to = (to > from ? G1 : C1) + (pos->stm == WHITE ? 0 : 56);
+      return !checkers && !attackers_to(pos, k_to, opp, pos->occupied ^ (1ULL << from) ^ (1ULL << to));
+
+    }
+
+    return !attackers_to(pos, to, opp, pos->occupied ^ (1ULL << from));
+
+  }
+
+  if (move & MOVE_FLAG_EPCAPTURE) {
+
+    const uint64_t cap = 1ULL << (to ^ 8);
+    const uint64_t occ = (pos->occupied ^ (1ULL << from) ^ cap) | (1ULL << to);
+
+    return !(attackers_to(pos, king_sq, opp, occ) & ~cap);
+
+  }
+
+  if (checkers) {
+    if (checkers & (checkers - 1))
+      return 0;
+    if (!((checkers | between_bb[king_sq][bsf(checkers)]) & (1ULL << to)))
+      return 0;
+  }
+
+  return !(li->pinned & (1ULL << from)) || (line_bb[king_sq][from] & (1ULL << to));
+
+}
+
+// pawns are generated a whole set at a time, so pinned ones and ep
+// captures are weeded out afterwards
+static int keep_legal_pawns(const Position *pos, const LegalInfo *li, move_t *m, const int n) {
+
+  if (!li->pinned && !pos->ep)
+    return n;
+
+  int k = 0;
+
+  for (int i=0; i < n; i++) {
+
+    const move_t move = m[i];
+    const int from = (move >> 6) & 0x3F;
+
+    if ((!((li->pinned >> from) & 1) && !(move & MOVE_FLAG_EPCAPTURE)) || is_legal_move(pos, li, move))
+      m[k++] = move;
+
+  }
+
+  return k;
+
+}
+
+// legal captures and promotions; in check only those resolving it, and
+// only king moves in double check
+int gen_noisy_moves(const Position *pos, const LegalInfo *li, move_t *m) {
 
-  const Position *pos = &node->pos;
   const int stm = pos->stm;
   const int opp = stm ^ 1;
-  const uint64_t opp_king_bb = pos->all[piece_index(KING, opp)];
-  const uint64_t opp_king_near = king_attacks[bsf(opp_king_bb)];
-  const uint64_t enemies = pos->colour[opp] & ~opp_king_bb;
+  const uint64_t *all = pos->all;
+  const uint64_t pinned = li->pinned;
+  const uint64_t enemies = pos->colour[opp] & ~all[piece_index(KING, opp)];
+  const uint64_t checkers = li->checkers;
   uint64_t cap_targets = enemies;
   uint64_t push_targets = ~pos->occupied;
+  int n = 0;
 
-  if (node->in_check) {
-    const int our_king_sq = bsf(pos->all[piece_index(KING, stm)]);
-    cap_targets &= all_attacks_inc_edge[our_king_sq];
-    push_targets &= all_attacks[our_king_sq];
+  if (checkers) {
+    cap_targets &= checkers;
+    push_targets &= between_bb[li->king_sq][bsf(checkers)];
   }
 
-  gen_pawns_captures(node, cap_targets);
-  gen_pawns_push_promos(node, push_targets);
-  gen_jumpers(node, knight_attacks, KNIGHT, cap_targets, MOVE_FLAG_CAPTURE);
-  gen_sliders(node, bishop_attacks, BISHOP, cap_targets, MOVE_FLAG_CAPTURE);
-  gen_sliders(node, rook_attacks, ROOK, cap_targets, MOVE_FLAG_CAPTURE);
-  gen_sliders(node, bishop_attacks, QUEEN, cap_targets, MOVE_FLAG_CAPTURE);
-  gen_sliders(node, rook_attacks, QUEEN, cap_targets, MOVE_FLAG_CAPTURE);
-  gen_jumpers(node, king_attacks, KING, enemies & ~opp_king_near, MOVE_FLAG_CAPTURE);
+  if (!(checkers & (checkers - 1))) {
+    n += gen_pawns_captures(pos, m + n, cap_targets);
+    n += gen_pawns_push_promos(pos, m + n, push_targets);
+    n = keep_legal_pawns(pos, li, m, n);
+    n += gen_jumpers(m + n, knight_attacks, all[piece_index(KNIGHT, stm)] & ~pinned, cap_targets, MOVE_FLAG_CAPTURE);
+    n += gen_sliders(pos, m + n, bishop_attacks, all[piece_index(BISHOP, stm)] & ~pinned, cap_targets, MOVE_FLAG_CAPTURE);
+    n += gen_sliders(pos, m + n, rook_attacks, all[piece_index(ROOK, stm)] & ~pinned, cap_targets, MOVE_FLAG_CAPTURE);
+    n += gen_sliders(pos, m + n, bishop_attacks, all[piece_index(QUEEN, stm)] & ~pinned, cap_targets, MOVE_FLAG_CAPTURE);
+    n += gen_sliders(pos, m + n, rook_attacks, all[piece_index(QUEEN, stm)] & ~pinned, cap_targets, MOVE_FLAG_CAPTURE);
+    if (pinned)
+      n += gen_pinned_sliders(pos, li, m + n, cap_targets, MOVE_FLAG_CAPTURE);
+  }
+
+  n += gen_king(pos, li, m + n, enemies, MOVE_FLAG_CAPTURE);
+
+  return n;
 
 }
 
-void gen_quiets(Node *node) {
+int gen_quiet_moves(const Position *pos, const LegalInfo *li, move_t *m) {
 
-  const Position *pos = &node->pos;
   const int stm = pos->stm;
-  const int opp = stm ^ 1;
+  const uint64_t *all = pos->all;
+  const uint64_t pinned = li->pinned;
   const uint64_t occ = pos->occupied;
-  const uint64_t opp_king_bb = pos->all[piece_index(KING, opp)];
-  const uint64_t opp_king_near = king_attacks[bsf(opp_king_bb)];
+  const uint64_t checkers = li->checkers;
   uint64_t targets = ~occ;
+  int n = 0;
+
+  if (checkers)
+    targets &= between_bb[li->king_sq][bsf(checkers)];
+
+  if (!(checkers & (checkers - 1))) {
+    n += gen_pawns_quiets(pos, m + n, targets);
+    n = keep_legal_pawns(pos, li, m, n);
+    n += gen_jumpers(m + n, knight_attacks, all[piece_index(KNIGHT, stm)] & ~pinned, targets, 0);
+    n += gen_sliders(pos, m + n, bishop_attacks, all[piece_index(BISHOP, stm)] & ~pinned, targets, 0);
+    n += gen_sliders(pos, m + n, rook_attacks, all[piece_index(ROOK, stm)] & ~pinned, targets, 0);
+    n += gen_sliders(pos, m + n, bishop_attacks, all[piece_index(QUEEN, stm)] & ~pinned, targets, 0);
+    n += gen_sliders(pos, m + n, rook_attacks, all[piece_index(QUEEN, stm)] & ~pinned, targets, 0);
+    if (pinned)
+      n += gen_pinned_sliders(pos, li, m + n, targets, 0);
+  }
+
+  n += gen_king(pos, li, m + n, ~occ, 0);
 
-  if (node->in_check) {
-    const int our_king_sq = bsf(pos->all[piece_index(KING, stm)]);
-    targets &= all_attacks[our_king_sq];
+  if (pos->rights && !checkers) {
+    const int end = n + gen_castling(pos, m + n);
+    for (int i=n; i < end; i++)
+      if (is_legal_move(pos, li, m[i]))
+        m[n++] = m[i];
   }
 
-  gen_pawns_quiets(node, targets);
-  gen_jumpers(node, knight_attacks, KNIGHT, targets, 0);
-  gen_sliders(node, bishop_attacks, BISHOP, targets, 0);
-  gen_sliders(node, rook_attacks, ROOK, targets, 0);
-  gen_sliders(node, bishop_attacks, QUEEN, targets, 0);
-  gen_sliders(node, rook_attacks, QUEEN, targets, 0);
-  gen_jumpers(node, king_attacks, KING, ~occ & ~opp_king_near, 0);
+  return n;
+
+}
+
+// every legal reply to a check: king steps, then in single check captures
+// of the checker and blocks on the check ray; a pinned piece can do
+// neither so only pawns, generated a set at a time, need weeding
+int gen_evasion_moves(const Position *pos, const LegalInfo *li, move_t *m) {
+
+  const int stm = pos->stm;
+  const int opp = stm ^ 1;
+  const uint64_t *all = pos->all;
+  const uint64_t checkers = li->checkers;
+  const uint64_t enemies = pos->colour[opp] & ~all[piece_index(KING, opp)];
+  int n = 0;
+
+  n += gen_king(pos, li, m + n, enemies, MOVE_FLAG_CAPTURE);
+  n += gen_king(pos, li, m + n, ~pos->occupied, 0);
+
+  if (checkers & (checkers - 1))
+    return n;
+
+  const uint64_t block = between_bb[li->king_sq][bsf(checkers)];
+  const uint64_t unpinned = ~li->pinned;
+  const uint64_t diag = (all[piece_index(BISHOP, stm)] | all[piece_index(QUEEN, stm)]) & unpinned;
+  const uint64_t orth = (all[piece_index(ROOK, stm)] | all[piece_index(QUEEN, stm)]) & unpinned;
+  const uint64_t knights = all[piece_index(KNIGHT, stm)] & unpinned;
+  const int pawns_at = n;
+
+  n += gen_pawns_captures(pos, m + n, checkers);
+  n += gen_pawns_push_promos(pos, m + n, block);
+  n += gen_pawns_quiets(pos, m + n, block);
+  n = pawns_at + keep_legal_pawns(pos, li, m + pawns_at, n - pawns_at);
+
+  n += gen_jumpers(m + n, knight_attacks, knights, checkers, MOVE_FLAG_CAPTURE);
+  n += gen_sliders(pos, m + n, bishop_attacks, diag, checkers, MOVE_FLAG_CAPTURE);
+  n += gen_sliders(pos, m + n, rook_attacks, orth, checkers, MOVE_FLAG_CAPTURE);
+
+  if (block) {
+    n += gen_jumpers(m + n, knight_attacks, knights, block, 0);
+    n += gen_sliders(pos, m + n, bishop_attacks, diag, block, 0);
+    n += gen_sliders(pos, m + n, rook_attacks, orth, block, 0);
+  }
+
+  return n;
+
+}
+
+void gen_noisy(Node *node) {
+
+  node->num_moves += gen_noisy_moves(&node->pos, &node->legal, node->moves + node->num_moves);
+
+}
+
+void gen_quiets(Node *node) {
+
+  node->num_moves += gen_quiet_moves(&node->pos, &node->legal, node->moves + node->num_moves);
+
+}
+
+void gen_evasions(Node *node) {
+
+  node->num_moves += gen_evasion_moves(&node->pos, &node->legal, node->moves + node->num_moves);
+
+}
+
+// legal moves from the position alone, no node or accumulators involved
+int gen_legal_moves(const Position *pos, move_t *legal) {
+
+  LegalInfo li;
+
+  legal_info(pos, &li);
+
+  if (li.checkers)
+    return gen_evasion_moves(pos, &li, legal);
+
+  const int n = gen_noisy_moves(pos, &li, legal);
 
-  if (pos->rights && !node->in_check)
-    gen_castling(node);
+  return n + gen_quiet_moves(pos, &li, legal + n);
 
 }
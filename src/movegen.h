@@ -1,6 +1,8 @@
 #ifndef MOVEGEN_H
 #define MOVEGEN_H
 
+#include "nodes.h"
+
 #define RANK_1 0x00000000000000FFULL
 #define RANK_2 0x000000000000FF00ULL
 #define RANK_3 0x0000000000FF0000ULL
@@ -9,7 +11,13 @@
 #define RANK_8 0xFF00000000000000ULL
 #define RANK_PROMO (RANK_1 | RANK_8)
 
+int is_legal_move(const Position *pos, const LegalInfo *li, const move_t move);
+int gen_noisy_moves(const Position *pos, const LegalInfo *li, move_t *m);
+int gen_quiet_moves(const Position *pos, const LegalInfo *li, move_t *m);
+int gen_evasion_moves(const Position *pos, const LegalInfo *li, move_t *m);
 void gen_quiets(Node *node);
 void gen_noisy(Node *node);
+void gen_evasions(Node *node);
+int gen_legal_moves(const Position *pos, move_t *legal);
 
 #endif
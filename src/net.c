@@ -25,6 +25,8 @@ static int16_t net_h1_b[NET_H1_SIZE];
 static int32_t net_o_w [NET_O_BUCKETS * NET_H1_SIZE * 2];
 static int32_t net_o_b [NET_O_BUCKETS];
 
+static char net_name[512] = "embedded";  // where the weights in use came from
+
 // king bucket layout in white pov; mirrored nets use files a-d only
 static const uint8_t net_bucket_map[64] = {
   0, 0, 1, 1, 1, 1, 0, 0,
@@ -157,16 +159,18 @@ int init_weights(void) {
   }
 
   unpack_weights((const int16_t *)cwtch_weights_data);
+  strcpy(net_name, "embedded");
   return 0;
 
 }
 
-int load_weights_from_file(const char *path) {
+// read a weights file into a malloced buffer for net_use_weights
+int16_t *net_read_weights(const char *path) {
 
   FILE *f = fopen(path, "rb");
   if (!f) {
     printf("info string cannot open %s\n", path);
-    return 1;
+    return NULL;
   }
 
   fseek(f, 0, SEEK_END);
@@ -176,27 +180,84 @@ int load_weights_from_file(const char *path) {
   if (bytes <= 0 || (size_t)bytes != NET_FILE_BYTES) {
     printf("info string %s is %llu bytes, expected %llu\n", path, (unsigned long long)bytes, (unsigned long long)NET_FILE_BYTES);
     fclose(f);
-    return 1;
+    return NULL;
   }
 
   int16_t *buf = (int16_t *)malloc(bytes);
   if (!buf) {
     printf("info string allocation failed\n");
     fclose(f);
-    return 1;
+    return NULL;
   }
 
   if (fread(buf, 1, bytes, f) != (size_t)bytes) {
     printf("info string read error\n");
     free(buf);
     fclose(f);
-    return 1;
+    return NULL;
   }
 
   fclose(f);
+  return buf;
+
+}
+
+// the weights in use, in file layout, in a malloced buffer for
+// net_use_weights
+int16_t *net_copy_weights(void) {
+
+  int16_t *buf = (int16_t *)calloc(1, NET_FILE_BYTES);
+  if (!buf) {
+    printf("info string allocation failed\n");
+    return NULL;
+  }
+
+  size_t offset = 0;
+
+  memcpy(buf, net_h1_w, sizeof(net_h1_w));
+
+  offset += NET_L0_SIZE;
+  memcpy(buf + offset, net_h1_b, sizeof(net_h1_b));
+
+  offset += NET_H1_SIZE;
+  for (int i=0; i < NET_O_BUCKETS * NET_H1_SIZE * 2; i++) {
+    buf[offset+i] = (int16_t)net_o_w[i];
+  }
+
+  offset += NET_O_BUCKETS * NET_H1_SIZE * 2;
+  for (int i=0; i < NET_O_BUCKETS; i++) {
+    buf[offset+i] = (int16_t)net_o_b[i];
+  }
+
+  return buf;
+
+}
+
+// the embedded net or the last file loaded
+const char *net_current_name(void) {
+
+  return net_name;
+
+}
+
+// switch to weights from net_read_weights or net_copy_weights, or the
+// embedded net if NULL
+void net_use_weights(const int16_t *weights) {
+
+  unpack_weights(weights ? weights : (const int16_t *)cwtch_weights_data);
+
+}
+
+int load_weights_from_file(const char *path) {
+
+  int16_t *buf = net_read_weights(path);
+  if (!buf)
+    return 1;
+
   unpack_weights(buf);
   free(buf);
 
+  snprintf(net_name, sizeof(net_name), "%s", path);
   printf("info string loaded %s\n", path);
   return 0;
 
@@ -513,6 +574,17 @@ void net_slow_rebuild_accs(Node *node) {
 
 }
 
+// refresh both accumulators through the finny cache
+void net_refresh_accs(Node *node) {
+
+  NetView v[2];
+  get_views(&node->pos, v);
+
+  net_refresh_acc(node, 0, &v[0]);
+  net_refresh_acc(node, 1, &v[1]);
+
+}
+
 int net_eval(Node *node) {
 
   const int stm = node->pos.stm;
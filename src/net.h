@@ -5,8 +5,13 @@
 
 int init_weights(void);
 int load_weights_from_file(const char *path);
+int16_t *net_read_weights(const char *path);
+int16_t *net_copy_weights(void);
+const char *net_current_name(void);
+void net_use_weights(const int16_t *weights);
 int net_eval(Node *node);
 void net_slow_rebuild_accs(Node *node);
+void net_refresh_accs(Node *node);
 void update_accs(Node *node, const int16_t (*src)[NET_H1_SIZE]);
 void lazy_update_accs(Node *node);
 void net_init_thread(void);
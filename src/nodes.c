@@ -2,12 +2,22 @@
 
 _Thread_local Node nodes[MAX_PLY];
 
+static _Thread_local NodeAccs node_accs[MAX_PLY];
+static _Thread_local move_t move_stack[MAX_PLY * MAX_MOVES];
+static _Thread_local int32_t rank_stack[MAX_PLY * MAX_MOVES];
+
+// also points this thread's nodes at its stacks, so every thread that
+// uses nodes calls it first
 void clear_nodes(void) {
 
   for (int i=0; i < MAX_PLY; i++) {
 
     Node *node = &nodes[i];
 
+    node->accs = node_accs[i].accs;
+    node->moves = &move_stack[i * MAX_MOVES];
+    node->ranks = &rank_stack[i * MAX_MOVES];
+    node->num_moves = 0;
     node->killer = 0;
     node->cont_entry = NULL;
     node->excluded_move = 0;
@@ -17,3 +27,18 @@ void clear_nodes(void) {
   }  
 
 }
+
+// on entering a node start its list, empty, where the parent's ends; the
+// parent has set up its own list by then and each ply adds at most
+// MAX_MOVES, so the stack cannot overflow
+void node_move_list(Node *node) {
+
+  if (node > nodes && node < nodes + MAX_PLY) {
+    const Node *parent = node - 1;
+    node->moves = parent->moves + parent->num_moves;
+    node->ranks = parent->ranks + parent->num_moves;
+  }
+
+  node->num_moves = 0;
+
+}
@@ -7,6 +7,7 @@
 
 #define MAX_PLY 64
 #define MAX_MOVES 256
+#define MAX_PLAYED 64  // moves a node keeps for the history updates
 
 enum {
   NET_OP_MOVE,
@@ -25,31 +26,43 @@ typedef struct {
 typedef struct {
 
   _Alignas(64) int16_t accs[2][NET_H1_SIZE];  // avoid cache line splits
+
+} NodeAccs;
+
+// the per ply header the search touches at every node; the accumulators
+// are on their own stack and the move lists are packed one after another
+// on a move stack, so a ply is a few hundred bytes rather than 5 KB
+typedef struct {
+
   Position pos;
-  NetDeferred net_deferred;
-  uint8_t accs_dirty;
-  move_t moves[MAX_MOVES];
-  move_t played[MAX_MOVES];
+  int16_t (*accs)[NET_H1_SIZE];  // this ply's NodeAccs
+  move_t *moves;                 // starts where the parent's list ends
+  int32_t *ranks;                // alongside moves
   int num_moves;
-  int32_t ranks[MAX_MOVES];
   int next_move;
+  int stage;
   int in_check;
   move_t tt_move;
   move_t excluded_move;  // se verification
-  int dextensions;       // double extensions on path
-  int stage;
-  int16_t ev;  // static eval
   move_t killer;
+  int16_t ev;  // static eval
+  uint8_t accs_dirty;
+  NetDeferred net_deferred;
+  int dextensions;       // double extensions on path
   int16_t (*cont_entry)[64];  // NULL at root and after null move
 
   /* Countermove tracking tracking fields */
   int prev_piece;
   int prev_to;
 
+  LegalInfo legal;  // checkers and pins for the legal generator
+  move_t played[MAX_PLAYED];
+
 } Node;
 
 extern _Thread_local Node nodes[MAX_PLY];
 
 void clear_nodes(void);
+void node_move_list(Node *node);
 
 #endif
@@ -2,7 +2,8 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
-#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include "nodes.h"
 #include "builtins.h"
 #include "movegen.h"
@@ -13,6 +14,8 @@
 #include "zobrist.h"
 #include "net.h"
 #include "debug.h"
+#include "perft.h"
+#include "move.h"
 
 typedef struct {
   const char *board;
@@ -24,39 +27,162 @@ typedef struct {
   const char *name;
 } PerftTest;
 
+// optional shared perft hash; an entry holds a node count for a position
+// at a depth, stored xor its check so a torn write just fails to match
+typedef struct {
+  uint64_t check;
+  uint64_t count;
+} PerftEntry;
+
+static PerftEntry *perft_table = NULL;
+static uint64_t perft_mask = 0;
+
+static inline uint64_t perft_key(const uint64_t hash, const int depth) {
+  return hash ^ ((uint64_t)depth * 0x9E3779B97F4A7C15ULL);
+}
+
+static int perft_hash_alloc(const int mb) {
+
+  if (mb < 1)
+    return 0;
+
+  uint64_t count = ((uint64_t)mb << 20) / sizeof(PerftEntry);
+  count = 1ULL << (63 - __builtin_clzll(count));
+
+  perft_table = calloc(count, sizeof(PerftEntry));
+  if (!perft_table) {
+    printf("error: cannot allocate %d MB perft hash\n", mb);
+    return 1;
+  }
+  perft_mask = count - 1;
+
+  return 0;
+
+}
+
+static void perft_hash_free(void) {
+
+  free(perft_table);
+  perft_table = NULL;
+  perft_mask = 0;
+
+}
+
+// legal moves straight from the generators, skipping the picker's ranking;
+// leaves are bulk counted at depth 1 without being made
+static uint64_t perft_pos(Position *pos, const int depth) {
+
+  const uint64_t key = perft_key(pos->hash, depth);
+  move_t moves[MAX_MOVES];
+  uint64_t tot_nodes = 0;
+
+  if (perft_table && depth > 1) {
+    const PerftEntry *e = &perft_table[key & perft_mask];
+    const uint64_t count = e->count;
+    if ((e->check ^ count) == key)
+      return count;
+  }
+
+  const int n = gen_legal_moves(pos, moves);
+
+  if (depth == 1)
+    return n;
+
+  for (int i=0; i < n; i++) {
+    Undo u;
+    make_move_undo(pos, moves[i], &u);
+    tot_nodes += perft_pos(pos, depth - 1);
+    unmake_move(pos, moves[i], &u);
+  }
+
+  if (perft_table) {
+    PerftEntry *e = &perft_table[key & perft_mask];
+    e->check = key ^ tot_nodes;
+    e->count = tot_nodes;
+  }
+
+  return tot_nodes;
+
+}
+
 uint64_t perft(const int depth, const int ply) {
 
   if (depth == 0)
     return 1;
 
-  Node *node = &nodes[ply];
-  Node *next_node = &nodes[ply+1];
-  const Position *pos = &node->pos;
-  Position *next_pos = &next_node->pos;
-  const int stm = pos->stm;
-  const int opp = stm ^ 1;
-  const int stm_king_idx = piece_index(KING, stm);
-  const int stm_king_sq = bsf(pos->all[stm_king_idx]);
-  const int in_check = is_attacked(pos, stm_king_sq, opp);
-  const uint64_t *const next_stm_king_ptr = &next_pos->all[stm_king_idx];
-  uint64_t tot_nodes = 0;
-  move_t move;
+  return perft_pos(&nodes[ply].pos, depth);
+
+}
 
-  init_next_search_move(node, in_check, 0);
+typedef struct {
+  const Position *root;
+  const move_t *moves;
+  uint64_t *counts;
+  int num_moves;
+  int depth;
+  _Atomic int next;
+} PerftSplit;
 
-  while ((move = get_next_search_move(node))) {
+// threads take root moves one at a time until none are left
+static void *perft_worker(void *arg) {
 
-    pos_copy(pos, next_pos);
-    make_move(next_node, move);
+  PerftSplit *ps = (PerftSplit *)arg;
+  Position child;
+  int i;
 
-    if (is_attacked(next_pos, bsf(*next_stm_king_ptr), opp))
-      continue;
+  while ((i = atomic_fetch_add(&ps->next, 1)) < ps->num_moves) {
+    pos_copy(ps->root, &child);
+    make_move_pos(&child, ps->moves[i]);
+    ps->counts[i] = ps->depth == 1 ? 1 : perft_pos(&child, ps->depth - 1);
+  }
+
+  return NULL;
 
-    tot_nodes += perft(depth-1, ply+1);
+}
 
+// perft of nodes[0] split over threads at the root, with an optional hash;
+// divide prints the count under every root move
+uint64_t perft_root(const int depth, int threads, const int hash_mb, const int divide) {
+
+  const Position *root = &nodes[0].pos;
+  move_t moves[MAX_MOVES];
+  uint64_t counts[MAX_MOVES];
+  pthread_t tids[PERFT_MAX_THREADS];
+  uint64_t total = 0;
+
+  if (depth < 1)
+    return 1;
+
+  if (threads < 1)
+    threads = 1;
+  if (threads > PERFT_MAX_THREADS)
+    threads = PERFT_MAX_THREADS;
+
+  if (perft_hash_alloc(hash_mb))
+    return 0;
+
+  PerftSplit ps = {root, moves, counts, gen_legal_moves(root, moves), depth, 0};
+
+  for (int t=1; t < threads; t++)
+    pthread_create(&tids[t], NULL, perft_worker, &ps);
+
+  perft_worker(&ps);
+
+  for (int t=1; t < threads; t++)
+    pthread_join(tids[t], NULL);
+
+  perft_hash_free();
+
+  for (int i=0; i < ps.num_moves; i++) {
+    total += counts[i];
+    if (divide) {
+      char buf[6];
+      format_move(moves[i], buf);
+      printf("%s: %llu\n", buf, (unsigned long long)counts[i]);
+    }
   }
 
-  return tot_nodes;
+  return total;
 
 }
 
@@ -130,12 +256,12 @@ static const PerftTest perft_tests_data[] = {
 
 #define NUM_PERFT_TESTS (sizeof(perft_tests_data) / sizeof(perft_tests_data[0]))
 
-void perft_tests(int max_depth) {
+void perft_tests(int max_depth, int threads, int hash_mb) {
 
   uint64_t total_nodes = 0;
   int errors = 0;
   int tests_run = 0;
-  clock_t start = clock();
+  uint64_t start = time_ms();
 
   if (max_depth > 0)
     printf("Running perft tests with depth <= %d...\n\n", max_depth);
@@ -153,7 +279,7 @@ void perft_tests(int max_depth) {
 
     position(&nodes[0], test->board, test->stm, test->rights, test->ep, 0, 0, NULL);
 
-    uint64_t result = perft(test->depth, 0);
+    uint64_t result = perft_root(test->depth, threads, hash_mb, 0);
 
     if (result != test->nodes) {
       printf("FAIL %s: depth %d, expected %lu, got %lu\n", test->name, test->depth, test->nodes, result);
@@ -168,8 +294,7 @@ void perft_tests(int max_depth) {
 
   }
 
-  clock_t end = clock();
-  double secs = (double)(end - start) / CLOCKS_PER_SEC;
+  double secs = (time_ms() - start) / 1000.0;
   uint64_t nps = secs > 0 ? (uint64_t)(total_nodes / secs) : 0;
 
   printf("\n");
@@ -3,7 +3,10 @@
 
 #include <stdint.h>
 
+#define PERFT_MAX_THREADS 256
+
 uint64_t perft(const int depth, const int ply);
-void perft_tests(int max_depth);
+uint64_t perft_root(const int depth, int threads, const int hash_mb, const int divide);
+void perft_tests(int max_depth, int threads, int hash_mb);
 
 #endif
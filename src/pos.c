@@ -6,6 +6,7 @@
 #include "pos.h"
 #include "makemove.h"
 #include "builtins.h"
+#include "move.h"
 
 void print_board(const Position *pos) {
 
@@ -62,8 +63,7 @@ int is_attacked(const Position *pos, const int sq, const int opp) {
   {
     const uint64_t attackers  = all[base+ROOK] | all_q;
     const Attack *a = &rook_attacks[sq];
-    const uint64_t blockers = occ & a->mask;
-    const uint64_t attacks  = a->attacks[magic_index(blockers, a->magic, a->shift)];
+    const uint64_t attacks  = slider_attacks(a, occ);
     if (attacks & attackers) 
       return 1;
   }
@@ -71,8 +71,7 @@ int is_attacked(const Position *pos, const int sq, const int opp) {
   {
     const uint64_t attackers  = all[base+BISHOP] | all_q;
     const Attack *a = &bishop_attacks[sq];
-    const uint64_t blockers = occ & a->mask;
-    const uint64_t attacks = a->attacks[magic_index(blockers, a->magic, a->shift)];
+    const uint64_t attacks = slider_attacks(a, occ);
     if (attacks & attackers) 
       return 1;
   }
@@ -81,6 +80,142 @@ int is_attacked(const Position *pos, const int sq, const int opp) {
 
 }
 
+// opp pieces attacking sq were the board occupied by occ
+uint64_t attackers_to(const Position *pos, const int sq, const int opp, const uint64_t occ) {
+
+  const uint64_t *all = pos->all;
+  const int base = colour_index(opp);
+
+  return (all[base+KNIGHT] & knight_attacks[sq])
+       | (all[base+PAWN]   & pawn_attacks[opp][sq])
+       | (all[base+KING]   & king_attacks[sq])
+       | ((all[base+ROOK]   | all[base+QUEEN]) & rook_attacks_bb(sq, occ))
+       | ((all[base+BISHOP] | all[base+QUEEN]) & bishop_attacks_bb(sq, occ));
+
+}
+
+// pieces in keep standing alone between sq and a slider of colour that sees
+// it on an empty board (index 0 either backend); pins and discovered checks alike
+static uint64_t lone_blockers(const Position *pos, const int sq, const int colour, const uint64_t keep) {
+
+  const uint64_t *all = pos->all;
+  const int base = colour_index(colour);
+  const uint64_t occ = pos->occupied;
+  uint64_t blockers = 0;
+  uint64_t snipers = (rook_attacks[sq].attacks[0]   & (all[base+ROOK]   | all[base+QUEEN]))
+                   | (bishop_attacks[sq].attacks[0] & (all[base+BISHOP] | all[base+QUEEN]));
+
+  while (snipers) {
+
+    const int from = bsf(snipers); snipers &= snipers - 1;
+    const uint64_t between = between_bb[sq][from] & occ;
+
+    if (between && !(between & (between - 1)))
+      blockers |= between & keep;
+
+  }
+
+  return blockers;
+
+}
+
+void legal_info(const Position *pos, LegalInfo *li) {
+
+  const int stm = pos->stm;
+  const int opp = stm ^ 1;
+  const int king_sq = bsf(pos->all[piece_index(KING, stm)]);
+
+  li->king_sq = king_sq;
+  li->checkers = attackers_to(pos, king_sq, opp, pos->occupied);
+  li->pinned = lone_blockers(pos, king_sq, opp, pos->colour[stm]);
+
+}
+
+void check_info(const Position *pos, CheckInfo *ci) {
+
+  const int stm = pos->stm;
+  const int king_sq = bsf(pos->all[piece_index(KING, stm ^ 1)]);
+  const uint64_t occ = pos->occupied;
+  const uint64_t diag = bishop_attacks_bb(king_sq, occ);
+  const uint64_t orth = rook_attacks_bb(king_sq, occ);
+
+  ci->king_sq = king_sq;
+  ci->check_sq[PAWN] = pawn_attacks[stm][king_sq];
+  ci->check_sq[KNIGHT] = knight_attacks[king_sq];
+  ci->check_sq[BISHOP] = diag;
+  ci->check_sq[ROOK] = orth;
+  ci->check_sq[QUEEN] = diag | orth;
+  ci->check_sq[KING] = 0;
+  ci->discoverers = lone_blockers(pos, king_sq, stm, pos->colour[stm]);
+
+}
+
+// does a legal move check the enemy king; plain moves and captures cost a
+// couple of bit tests, the rarer kinds redo the sums with the new occupancy
+int gives_check(const Position *pos, const CheckInfo *ci, const uint32_t move) {
+
+  const int stm = pos->stm;
+  const int from = (move >> 6) & 0x3F;
+  const int to = move & 0x3F;
+  const int king_sq = ci->king_sq;
+  const uint64_t from_bb = 1ULL << from;
+  const uint64_t to_bb = 1ULL << to;
+  const uint64_t *all = pos->all;
+  const int base = colour_index(stm);
+
+  if (move & MOVE_FLAG_CASTLE) {
+
+    // the king lands on g or c and the rook beside it on f or d
+    const int rank = stm == WHITE ? 0 : 56;
+    const uint64_t k_to = 1ULL << ((to > from ? G1 : C1) + rank);
+    const uint64_t r_to = 1ULL << ((to > from ? F1 : D1) + rank);
+    const uint64_t occ = (pos->occupied ^ from_bb ^ to_bb) | k_to | r_to;
+    const uint64_t orth = ((all[base+ROOK] ^ to_bb) | r_to | all[base+QUEEN]);
+    const uint64_t diag = all[base+BISHOP] | all[base+QUEEN];
+
+    return ((rook_attacks_bb(king_sq, occ) & orth) | (bishop_attacks_bb(king_sq, occ) & diag)) != 0;
+
+  }
+
+  if (move & MOVE_FLAG_PROMOTE) {
+
+    const uint64_t occ = pos->occupied ^ from_bb;
+    const int promo = (move >> 12) & 0x7;
+
+    if ((ci->discoverers & from_bb) && !(line_bb[king_sq][from] & to_bb))
+      return 1;
+
+    switch (promo) {
+      case KNIGHT: return (knight_attacks[to] >> king_sq) & 1;
+      case BISHOP: return (bishop_attacks_bb(to, occ) >> king_sq) & 1;
+      case ROOK:   return (rook_attacks_bb(to, occ) >> king_sq) & 1;
+      default:     return ((bishop_attacks_bb(to, occ) | rook_attacks_bb(to, occ)) >> king_sq) & 1;
+    }
+
+  }
+
+  if (ci->check_sq[piece_type(pos->board[from])] & to_bb)
+    return 1;
+
+  if ((ci->discoverers & from_bb) && !(line_bb[king_sq][from] & to_bb))
+    return 1;
+
+  if (move & MOVE_FLAG_EPCAPTURE) {
+
+    // the captured pawn may have been the last piece on a line
+    const uint64_t cap = 1ULL << (to ^ 8);
+    const uint64_t occ = (pos->occupied ^ from_bb ^ cap) | to_bb;
+    const uint64_t orth = all[base+ROOK] | all[base+QUEEN];
+    const uint64_t diag = all[base+BISHOP] | all[base+QUEEN];
+
+    return ((rook_attacks_bb(king_sq, occ) & orth) | (bishop_attacks_bb(king_sq, occ) & diag)) != 0;
+
+  }
+
+  return 0;
+
+}
+
 int is_mat_draw(const Position *pos) {
 
   const uint64_t *all = pos->all;
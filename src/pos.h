@@ -31,6 +31,26 @@ typedef struct {
 
 } Position;
 
+// what the legal generator needs to know about the side to move's king,
+// worked out once per node
+typedef struct {
+
+  uint64_t checkers;  // enemy pieces giving check
+  uint64_t pinned;    // our pieces pinned to our king
+  int king_sq;
+
+} LegalInfo;
+
+// squares from which each of our piece types would check the enemy king,
+// and our pieces whose moving off the line to it may uncover a check
+typedef struct {
+
+  uint64_t check_sq[6];
+  uint64_t discoverers;
+  int king_sq;  // the enemy king
+
+} CheckInfo;
+
 inline void pos_copy(const Position *from_pos, Position *to_pos) {
   *to_pos = *from_pos;
 }
@@ -42,6 +62,10 @@ inline int is_pawn_endgame(const Position *pos) {
 
 void print_board(const Position *pos);
 int is_attacked(const Position *pos, const int sq, const int opp);
+uint64_t attackers_to(const Position *pos, const int sq, const int opp, const uint64_t occ);
+void legal_info(const Position *pos, LegalInfo *li);
+void check_info(const Position *pos, CheckInfo *ci);
+int gives_check(const Position *pos, const CheckInfo *ci, const uint32_t move);
 int is_mat_draw(const Position *pos);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,259 @@
+#include <stdio.h>
+#include <string.h>
+#include "profile.h"
+
+#if defined(__linux__) && (defined(__x86_64__) || defined(__i386__))
+  #include <cpuid.h>
+#endif
+
+#ifdef __linux__
+  #include <unistd.h>
+  #include <sys/ioctl.h>
+  #include <sys/syscall.h>
+  #include <linux/perf_event.h>
+#endif
+
+ProfCounts prof_thread_counts[PROF_MAX_THREADS];
+int prof_threads = 0;
+
+#ifdef __linux__
+
+static long prof_event_open(struct perf_event_attr *attr) {
+
+  return syscall(SYS_perf_event_open, attr, 0, -1, -1, 0);
+
+}
+
+static uint64_t prof_cache(const int cache, const int op, const int result) {
+
+  return (uint64_t)cache | ((uint64_t)op << 8) | ((uint64_t)result << 16);
+
+}
+
+// there is no generic l2 event, so use the raw one for the vendor: intel
+// L2_RQSTS.MISS (skylake on) or amd zen l2_cache_req_stat.ls_rd_blk_c,
+// data cache reads that miss l2; 0 leaves the column empty
+static uint64_t prof_l2_raw(void) {
+
+#if defined(__x86_64__) || defined(__i386__)
+
+  unsigned a, b, c, d;
+
+  if (!__get_cpuid(0, &a, &b, &c, &d))
+    return 0;
+  if (b == signature_INTEL_ebx)
+    return 0x3F24;
+  if (b == signature_AMD_ebx)
+    return 0x0864;
+
+#endif
+
+  return 0;
+
+}
+
+// open the counters for the calling thread, stopped; user space only so a
+// perf_event_paranoid of 2 is enough
+int prof_open(ProfSet *set) {
+
+  const uint32_t types[PROF_EVENTS] = {
+    PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_RAW,
+    PERF_TYPE_HW_CACHE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE
+  };
+
+  const uint64_t configs[PROF_EVENTS] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    prof_cache(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS),
+    prof_l2_raw(),
+    prof_cache(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS),
+    prof_cache(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS),
+    PERF_COUNT_HW_BRANCH_MISSES
+  };
+
+  int opened = 0;
+
+  for (int i=0; i < PROF_EVENTS; i++) {
+
+    struct perf_event_attr attr;
+
+    if (types[i] == PERF_TYPE_RAW && !configs[i]) {
+      set->fd[i] = -1;
+      continue;
+    }
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = types[i];
+    attr.config = configs[i];
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    set->fd[i] = (int)prof_event_open(&attr);
+    opened += set->fd[i] >= 0;
+
+  }
+
+  if (!opened) {
+    prof_close(set);
+    return 1;
+  }
+
+  return 0;
+
+}
+
+void prof_close(ProfSet *set) {
+
+  for (int i=0; i < PROF_EVENTS; i++) {
+    if (set->fd[i] >= 0)
+      close(set->fd[i]);
+    set->fd[i] = -1;
+  }
+
+}
+
+void prof_start(ProfSet *set) {
+
+  for (int i=0; i < PROF_EVENTS; i++) {
+    if (set->fd[i] >= 0) {
+      ioctl(set->fd[i], PERF_EVENT_IOC_RESET, 0);
+      ioctl(set->fd[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+
+}
+
+// stop the counters and add them to c, each scaled up for the time it was
+// multiplexed out; an event the host lacks or that never ran stays invalid
+void prof_stop(ProfSet *set, ProfCounts *c) {
+
+  for (int i=0; i < PROF_EVENTS; i++) {
+
+    uint64_t r[3] = {0};  // value, time enabled, time running
+
+    if (set->fd[i] < 0)
+      continue;
+
+    ioctl(set->fd[i], PERF_EVENT_IOC_DISABLE, 0);
+
+    if (read(set->fd[i], r, sizeof(r)) != sizeof(r))
+      continue;
+
+    c->enabled[i] += r[1];
+    c->running[i] += r[2];
+
+    if (r[2]) {
+      c->v[i] += r[2] < r[1] ? (uint64_t)((double)r[0] * r[1] / r[2]) : r[0];
+      c->valid |= 1 << i;
+    }
+
+  }
+
+}
+
+#else
+
+int prof_open(ProfSet *set) {
+
+  for (int i=0; i < PROF_EVENTS; i++)
+    set->fd[i] = -1;
+
+  return 1;
+
+}
+
+void prof_close(ProfSet *set) {
+
+  (void)set;
+
+}
+
+void prof_start(ProfSet *set) {
+
+  (void)set;
+
+}
+
+void prof_stop(ProfSet *set, ProfCounts *c) {
+
+  (void)set;
+  (void)c;
+
+}
+
+#endif
+
+void prof_add(ProfCounts *to, const ProfCounts *from) {
+
+  for (int i=0; i < PROF_EVENTS; i++) {
+    to->v[i] += from->v[i];
+    to->enabled[i] += from->enabled[i];
+    to->running[i] += from->running[i];
+  }
+
+  to->valid |= from->valid;
+
+}
+
+void prof_sub(ProfCounts *to, const ProfCounts *from) {
+
+  for (int i=0; i < PROF_EVENTS; i++) {
+    to->v[i] -= from->v[i];
+    to->enabled[i] -= from->enabled[i];
+    to->running[i] -= from->running[i];
+  }
+
+}
+
+void prof_header(void) {
+
+  printf(" %6s %7s %7s %7s %7s %7s", "ipc", "l1d", "l2", "llc", "dtlb", "brmiss");
+
+}
+
+static const char *const prof_names[PROF_EVENTS] = {"cycles", "instr", "l1d", "l2", "llc", "dtlb", "brmiss"};
+
+// ipc, then each miss count per unit of work (an op or a thousand nodes)
+void prof_print(const ProfCounts *c, const double work) {
+
+  const int has_ipc = (c->valid & 3) == 3 && c->v[PROF_CYCLES];
+
+  if (has_ipc)
+    printf(" %6.2f", (double)c->v[PROF_INSTRUCTIONS] / (double)c->v[PROF_CYCLES]);
+  else
+    printf(" %6s", "-");
+
+  for (int i=PROF_L1D_MISSES; i < PROF_EVENTS; i++) {
+    if (c->valid & (1 << i))
+      printf(" %7.2f", (double)c->v[i] / (work > 0 ? work : 1));
+    else
+      printf(" %7s", "-");
+  }
+
+}
+
+// say which counts were scaled because their event shared a counter, and
+// for what share of the time each one actually ran
+void prof_coverage(const ProfCounts *c) {
+
+  int shared = 0;
+
+  for (int i=0; i < PROF_EVENTS; i++)
+    shared |= c->enabled[i] && c->running[i] < c->enabled[i];
+
+  if (!shared)
+    return;
+
+  printf("profile: counters were multiplexed, counts are scaled from the time each ran:");
+
+  for (int i=0; i < PROF_EVENTS; i++) {
+    if (c->enabled[i])
+      printf(" %s %.0f%%", prof_names[i], 100.0 * c->running[i] / c->enabled[i]);
+  }
+
+  printf("\n");
+
+}
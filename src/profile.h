@@ -0,0 +1,50 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+
+#define PROF_MAX_THREADS 256
+
+enum {
+  PROF_CYCLES,
+  PROF_INSTRUCTIONS,
+  PROF_L1D_MISSES,
+  PROF_L2_MISSES,
+  PROF_LLC_MISSES,
+  PROF_DTLB_MISSES,
+  PROF_BRANCH_MISSES,
+  PROF_EVENTS
+};
+
+typedef struct {
+
+  int fd[PROF_EVENTS];
+
+} ProfSet;
+
+// the kernel multiplexes events when there are more than counters, so each
+// count is scaled by the time it was enabled over the time it ran
+typedef struct {
+
+  uint64_t v[PROF_EVENTS];        // scaled counts
+  uint64_t enabled[PROF_EVENTS];  // ns
+  uint64_t running[PROF_EVENTS];  // ns
+  int valid;  // bit per event the host counted
+
+} ProfCounts;
+
+// when set, search threads count their own events into prof_thread_counts
+extern ProfCounts prof_thread_counts[PROF_MAX_THREADS];
+extern int prof_threads;
+
+int prof_open(ProfSet *set);
+void prof_close(ProfSet *set);
+void prof_start(ProfSet *set);
+void prof_stop(ProfSet *set, ProfCounts *c);
+void prof_add(ProfCounts *to, const ProfCounts *from);
+void prof_sub(ProfCounts *to, const ProfCounts *from);
+void prof_header(void);
+void prof_print(const ProfCounts *c, const double work);
+void prof_coverage(const ProfCounts *c);
+
+#endif
@@ -15,6 +15,7 @@
 #include "see.h"
 #include "debug.h"
 #include "pv.h"
+#include "stats.h"
 #include <stdatomic.h>
 
 _Thread_local int qsearch_local_node_batch = 0;
@@ -35,13 +36,14 @@ int qsearch(const int ply, int alpha, const int beta) {
   //if (is_mat_draw(pos))
     //return 0;
 
-  const int stm = pos->stm;
-  const int opp = stm ^ 1;
-  const int stm_king_idx = piece_index(KING, stm);
-  const int in_check = 0; //is_attacked(pos, bsf(pos->all[stm_king_idx]), opp); // for minor move gen captures optimisation only
+  legal_info(pos, &node->legal);
+  node_move_list(node);
 
+  const int in_check = node->legal.checkers != 0;
+
+  // in check there is no standing pat, every evasion is searched
   lazy_update_accs(node);
-  int stand_pat = correct_eval(pos, net_eval(node));
+  const int stand_pat = in_check ? -INF : correct_eval(pos, net_eval(node));
 
   if (stand_pat >= beta) {
     return stand_pat;
@@ -50,26 +52,31 @@ int qsearch(const int ply, int alpha, const int beta) {
     alpha = stand_pat;
   }
 
-  TimeControl *tc = &time_control;
+  TimeControl *tc = thread_tc;
   qsearch_local_node_batch++;
 
 if (qsearch_local_node_batch >= 1024) {
-    atomic_fetch_add_explicit(&time_control.nodes, 1024, memory_order_relaxed);
+    atomic_fetch_add_explicit(&tc->nodes, 1024, memory_order_relaxed);
     qsearch_local_node_batch = 0;
     
     check_tc_nodes(); // Or check_time() / whatever function Cwtch uses
 }
 
+  STAT_INC(qsearch_nodes);
+
   const TT *entry = tt_get(pos);
+  STAT_INC(qs_tt_probes);
   if (entry) {
     const int tt_flags = entry->flags;
     const int tt_score = get_adjusted_score(ply, entry->score);
+    STAT_INC(qs_tt_hits);
     if (tt_flags == TT_EXACT || (tt_flags == TT_BETA && tt_score >= beta) || (tt_flags == TT_ALPHA && tt_score <= alpha)) {
+      STAT_INC(qs_tt_cutoffs);
       return tt_score;
     }
   }
 
-  const move_t tt_move = entry && (entry->move & MOVE_FLAG_CAPTURE) ? entry->move : 0;
+  const move_t tt_move = entry && (in_check || (entry->move & MOVE_FLAG_CAPTURE)) ? entry->move : 0;
   Node *next_node = &nodes[ply + 1];
   Position *next_pos = &next_node->pos;
   move_t move;
@@ -78,8 +85,7 @@ if (qsearch_local_node_batch >= 1024) {
   int best_score = stand_pat;
   //int played = 0;
   const int orig_alpha = alpha;
-  const uint64_t *next_stm_king_ptr = &next_pos->all[stm_king_idx];
-  
+
   init_next_qsearch_move(node, in_check, tt_move);
 
   while ((move = get_next_qsearch_move(node))) {
@@ -91,8 +97,6 @@ if (qsearch_local_node_batch >= 1024) {
     pos_copy(pos, next_pos);
     make_move(next_node, move);
     tt_prefetch(next_pos->hash);
-    if (is_attacked(next_pos, bsf(*next_stm_king_ptr), opp))
-      continue;
 
     next_node->accs_dirty = 1;
 
@@ -116,6 +120,9 @@ if (qsearch_local_node_batch >= 1024) {
     }
   }
 
+  if (best_score == -INF)
+    return -MATE + ply;
+
   tt_put(pos, (alpha > orig_alpha) ? TT_EXACT : TT_ALPHA, 0, put_adjusted_score(ply, best_score), best_move); 
 
   return best_score;
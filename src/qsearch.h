@@ -1,6 +1,8 @@
 #ifndef QSEARCH_H
 #define QSEARCH_H
 
+extern _Thread_local int qsearch_local_node_batch;
+
 int qsearch(const int ply, int alpha, const int beta);
 
 #endif
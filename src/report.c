@@ -8,7 +8,7 @@ void report(int depth) {
   int next_pv_char = 0;
   move_t *const pv = pv_table[0];
   char pv_str[MAX_PLY * 6 + 1];
-  TimeControl *tc = &time_control;
+  TimeControl *tc = thread_tc;
     
   for (int i=pvl-1; i >= 0; i--) {
     next_pv_char += format_move(pv[i], &pv_str[next_pv_char]);
@@ -0,0 +1,358 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "rescore.h"
+#include "types.h"
+#include "nodes.h"
+#include "pos.h"
+#include "move.h"
+#include "makemove.h"
+#include "tt.h"
+#include "hh.h"
+#include "timecontrol.h"
+#include "go.h"
+#include "search.h"
+#include "qsearch.h"
+#include "net.h"
+#include "uci.h"
+#include "mapfile.h"
+#include "viri.h"
+
+#define RS_MAX_THREADS  256
+#define RS_CHUNK_GAMES  64    // games per work item
+#define RS_HASH_MB      16    // private tt per worker
+#define RS_REPORT_SECS  10
+
+typedef struct {
+  size_t begin;
+  size_t end;
+} RsChunk;
+
+// the output has exactly the input's layout, so each chunk is written back
+// at its own offset and chunks can finish in any order
+typedef struct {
+  MappedFile in;
+  FILE *out;
+  int64_t search_nodes;
+  RsChunk *chunks;
+  int num_chunks;
+  _Atomic int next_chunk;
+  _Atomic uint64_t positions;
+  _Atomic uint64_t games;
+  _Atomic uint64_t skipped;
+  _Atomic int failed;  // chunks copied through without rescoring, or short writes
+  uint64_t total_positions;
+  uint64_t start_time;
+  pthread_mutex_t out_lock;
+} RsShared;
+
+typedef struct {
+  RsShared *shared;
+  int id;
+} RsWorker;
+
+static void rs_write(RsShared *rs, const size_t offset, const uint8_t *buf, const size_t len) {
+
+  pthread_mutex_lock(&rs->out_lock);
+
+#ifdef _WIN32
+  _fseeki64(rs->out, (long long)offset, SEEK_SET);
+#else
+  fseeko(rs->out, (off_t)offset, SEEK_SET);
+#endif
+
+  if (fwrite(buf, 1, len, rs->out) != len) {
+    printf("error: rescore short write\n");
+    atomic_fetch_add(&rs->failed, 1);
+  }
+
+  pthread_mutex_unlock(&rs->out_lock);
+
+}
+
+// search every position of the game in rec and overwrite its score, and
+// the PackedBoard eval (bytes 28-29) with position 0's, as datagen writes
+// it; a game that does not replay is left as it is
+static int rs_game(RsShared *rs, uint8_t *rec, const size_t len) {
+
+  const int num_moves = (int)((len - VIRI_BOARD_BYTES) / VIRI_MOVE_BYTES) - 1;
+  uint8_t *entries = rec + VIRI_BOARD_BYTES;
+  Position *pos = &nodes[0].pos;
+
+  new_game();
+
+  // node counts are flushed in batches; start every game from an empty
+  // batch so rescoring is repeatable
+  search_local_node_batch = 0;
+  qsearch_local_node_batch = 0;
+
+  if (packed_board_to_pos(rec, pos))
+    return 1;
+
+  hh_reset();
+  hh_push(pos->hash);
+
+  for (int i = 0; i < num_moves; i++) {
+
+    ViriMove vm;
+    memcpy(&vm, entries + i * VIRI_MOVE_BYTES, VIRI_MOVE_BYTES);
+
+    const move_t move = viri_to_move(pos, vm.move);
+    if (!move)
+      return 1;
+
+    init_tc(0, 0, 0, 0, rs->search_nodes, 0, 0, 0);
+    thread_tc->best_move = 0;
+    thread_tc->best_score = 0;
+    go(1);
+
+    const int score = thread_tc->best_score;
+    vm.score = (int16_t)(pos->stm == WHITE ? score : -score);
+    memcpy(entries + i * VIRI_MOVE_BYTES, &vm, VIRI_MOVE_BYTES);
+
+    if (i == 0)
+      memcpy(rec + 28, &vm.score, 2);
+
+    make_move_pos(pos, move);
+    hh_push(pos->hash);
+
+  }
+
+  return 0;
+
+}
+
+static void rs_report(RsShared *rs, const uint64_t now) {
+
+  const uint64_t done = atomic_load(&rs->positions);
+  const uint64_t elapsed = now - rs->start_time;
+  const uint64_t pps = elapsed ? done * 1000ULL / elapsed : 0;
+
+  printf("rescore: %llu/%llu positions (%.1f%%) %llu pos/s\n",
+    (unsigned long long)done,
+    (unsigned long long)rs->total_positions,
+    rs->total_positions ? 100.0 * done / rs->total_positions : 0.0,
+    (unsigned long long)pps);
+  fflush(stdout);
+
+}
+
+// a chunk that cannot be rescored still goes out unchanged so the output
+// has no holes, but the run fails
+static void rs_copy_chunk(RsShared *rs, const RsChunk *ch) {
+
+  rs_write(rs, ch->begin, rs->in.data + ch->begin, ch->end - ch->begin);
+  atomic_fetch_add(&rs->failed, 1);
+
+}
+
+static void *rs_worker(void *arg) {
+
+  RsWorker *w = (RsWorker *)arg;
+  RsShared *rs = w->shared;
+  uint8_t *buf = NULL;
+  size_t cap = 0;
+  int c;
+
+  if (go_private_init(RS_HASH_MB)) {
+    printf("error: worker %d cannot allocate search state\n", w->id);
+    return NULL;
+  }
+
+  net_init_thread();
+  clear_nodes();
+
+  uint64_t last_report = time_ms();
+
+  while ((c = atomic_fetch_add(&rs->next_chunk, 1)) < rs->num_chunks) {
+
+    const RsChunk *ch = &rs->chunks[c];
+    const size_t len = ch->end - ch->begin;
+
+    if (len > cap) {
+      uint8_t *grown = realloc(buf, len);
+      if (!grown) {
+        printf("error: rescore out of memory\n");
+        rs_copy_chunk(rs, ch);
+        continue;
+      }
+      buf = grown;
+      cap = len;
+    }
+
+    memcpy(buf, rs->in.data + ch->begin, len);
+
+    size_t offset = 0;
+    while (offset < len) {
+      const size_t end = viri_record_end(buf, len, offset);
+      const uint64_t moves = (end - offset - VIRI_BOARD_BYTES) / VIRI_MOVE_BYTES - 1;
+      if (rs_game(rs, buf + offset, end - offset)) {
+        memcpy(buf + offset, rs->in.data + ch->begin + offset, end - offset);
+        atomic_fetch_add(&rs->skipped, 1);
+      }
+      atomic_fetch_add(&rs->positions, moves);
+      atomic_fetch_add(&rs->games, 1);
+      offset = end;
+    }
+
+    rs_write(rs, ch->begin, buf, len);
+
+    const uint64_t now = time_ms();
+    if (w->id == 0 && now - last_report >= RS_REPORT_SECS * 1000) {
+      rs_report(rs, now);
+      last_report = now;
+    }
+
+  }
+
+  free(buf);
+  go_private_free();
+
+  return NULL;
+
+}
+
+static int rs_add_chunk(RsShared *rs, int *cap, const size_t begin, const size_t end) {
+
+  if (rs->num_chunks == *cap) {
+    *cap = *cap ? *cap * 2 : 1024;
+    RsChunk *grown = realloc(rs->chunks, *cap * sizeof(RsChunk));
+    if (!grown)
+      return 1;
+    rs->chunks = grown;
+  }
+
+  rs->chunks[rs->num_chunks++] = (RsChunk){begin, end};
+
+  return 0;
+
+}
+
+// cut the input into chunks of whole games; bytes after the last complete
+// record are copied through untouched
+static int rs_index(RsShared *rs) {
+
+  int cap = 0;
+  size_t offset = 0;
+  size_t begin = 0;
+  int games = 0;
+
+  while (offset < rs->in.size) {
+
+    const size_t end = viri_record_end(rs->in.data, rs->in.size, offset);
+    if (!end) {
+      printf("rescore: %llu trailing bytes are not a complete game and are copied as they are\n",
+        (unsigned long long)(rs->in.size - offset));
+      break;
+    }
+
+    rs->total_positions += (end - offset - VIRI_BOARD_BYTES) / VIRI_MOVE_BYTES - 1;
+    offset = end;
+
+    if (++games == RS_CHUNK_GAMES) {
+      if (rs_add_chunk(rs, &cap, begin, offset))
+        return 1;
+      begin = offset;
+      games = 0;
+    }
+
+  }
+
+  if (offset > begin && rs_add_chunk(rs, &cap, begin, offset))
+    return 1;
+
+  // the tail, if any, goes out first so the file has its final size
+  if (offset < rs->in.size)
+    rs_write(rs, offset, rs->in.data + offset, rs->in.size - offset);
+
+  return 0;
+
+}
+
+void rescore(const char *in_path, const char *out_path, const int64_t search_nodes, int threads) {
+
+  static RsWorker workers[RS_MAX_THREADS];
+  pthread_t handles[RS_MAX_THREADS];
+  RsShared rs;
+
+  if (threads < 1) threads = 1;
+  if (threads > RS_MAX_THREADS) threads = RS_MAX_THREADS;
+
+  if (search_nodes < 1) {
+    printf("error: rescore needs a node count\n");
+    return;
+  }
+
+  memset(&rs, 0, sizeof(rs));
+  rs.search_nodes = search_nodes;
+
+  if (map_file(&rs.in, in_path)) {
+    printf("error: cannot read %s\n", in_path);
+    return;
+  }
+
+  rs.out = fopen(out_path, "wb");
+  if (!rs.out) {
+    printf("error: cannot open %s\n", out_path);
+    unmap_file(&rs.in);
+    return;
+  }
+
+  pthread_mutex_init(&rs.out_lock, NULL);
+
+  if (rs_index(&rs)) {
+    printf("error: rescore out of memory\n");
+    pthread_mutex_destroy(&rs.out_lock);
+    fclose(rs.out);
+    unmap_file(&rs.in);
+    return;
+  }
+
+  printf("rescore: %s -> %s, %llu positions, %d nodes, %d threads\n", in_path, out_path,
+    (unsigned long long)rs.total_positions, (int)search_nodes, threads);
+  fflush(stdout);
+
+  // each worker searches single threaded
+  const int saved_threads = num_threads;
+  num_threads = 1;
+
+  rs.start_time = time_ms();
+
+  for (int i = 0; i < threads; i++) {
+    workers[i].shared = &rs;
+    workers[i].id = i;
+  }
+
+  for (int i = 1; i < threads; i++)
+    pthread_create(&handles[i], NULL, rs_worker, &workers[i]);
+
+  // the calling thread is worker 0 and reports progress
+  rs_worker(&workers[0]);
+
+  for (int i = 1; i < threads; i++)
+    pthread_join(handles[i], NULL);
+
+  num_threads = saved_threads;
+
+  // chunks left over when every worker failed to start
+  for (int c = atomic_load(&rs.next_chunk); c < rs.num_chunks; c++)
+    rs_copy_chunk(&rs, &rs.chunks[c]);
+
+  pthread_mutex_destroy(&rs.out_lock);
+  fclose(rs.out);
+  unmap_file(&rs.in);
+  free(rs.chunks);
+
+  if (atomic_load(&rs.failed))
+    printf("error: rescore failed, %s is incomplete\n", out_path);
+
+  printf("rescore: %s. %llu positions %llu games, %llu games left unchanged\n",
+    atomic_load(&rs.failed) ? "failed" : "done",
+    (unsigned long long)atomic_load(&rs.positions),
+    (unsigned long long)atomic_load(&rs.games),
+    (unsigned long long)atomic_load(&rs.skipped));
+
+}
@@ -0,0 +1,8 @@
+#ifndef RESCORE_H
+#define RESCORE_H
+
+#include <stdint.h>
+
+void rescore(const char *in_path, const char *out_path, const int64_t search_nodes, int threads);
+
+#endif
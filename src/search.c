@@ -20,6 +20,8 @@
 #include "debug.h"
 #include "pv.h"
 #include "see.h"
+#include "stats.h"
+#include "trace.h"
 #include <stdatomic.h>
 
 _Thread_local int search_local_node_batch = 0;
@@ -34,7 +36,27 @@ void init_lmr(void) {
   }
 }
 
-int search(const int ply, int depth, int alpha, int beta) {
+static int search_body(const int ply, int depth, int alpha, int beta);
+
+// the search entry point; node enter and exit are traced (or sampled) here
+// so the body keeps its many early returns
+int search(const int ply, const int depth, const int alpha, const int beta) {
+
+  if (!trace_ring)
+    return search_body(ply, depth, alpha, beta);
+
+  if (trace_ring->sample)
+    trace_ring->sample(ply, depth);
+
+  trace_event(TRACE_ENTER, ply, depth, 0, alpha, beta, 0);
+  const int score = search_body(ply, depth, alpha, beta);
+  trace_event(TRACE_EXIT, ply, depth, 0, score, 0, 0);
+
+  return score;
+
+}
+
+static int search_body(const int ply, int depth, int alpha, int beta) {
 
   Node *node = &nodes[ply];
   pv_len[ply] = 0;
@@ -52,10 +74,10 @@ int search(const int ply, int depth, int alpha, int beta) {
     }
   }
 
-  const int stm = pos->stm;
-  const int opp = stm ^ 1;
-  const int stm_king_idx = piece_index(KING, stm);
-  const int in_check = is_attacked(pos, bsf(pos->all[stm_king_idx]), opp);
+  legal_info(pos, &node->legal);
+  node_move_list(node);
+
+  const int in_check = node->legal.checkers != 0;
   const int is_root = ply == 0;
   const int is_pv = is_root || (beta - alpha != 1);
   const move_t excluded = node->excluded_move;
@@ -67,16 +89,18 @@ int search(const int ply, int depth, int alpha, int beta) {
   if (depth < 0)
     depth = 0;
 
-  TimeControl *tc = &time_control;
+  TimeControl *tc = thread_tc;
   search_local_node_batch++;
 
 if (search_local_node_batch >= 1024) {
-    atomic_fetch_add_explicit(&time_control.nodes, 1024, memory_order_relaxed);
+    atomic_fetch_add_explicit(&tc->nodes, 1024, memory_order_relaxed);
     search_local_node_batch = 0;
     
     check_tc_nodes(); // Or check_time() / whatever function Cwtch uses to check time limits
 }
 
+  STAT_INC(search_nodes);
+
   if (alpha < -MATE + ply)
     alpha = -MATE + ply;
   if (beta > MATE - ply - 1)
@@ -85,10 +109,18 @@ if (search_local_node_batch >= 1024) {
     return alpha;
 
   const TT *entry = tt_get(pos);
+  STAT_INC_D(tt_probes, depth);
+  STAT_ADD_D(tt_hits, depth, entry != NULL);
+  if (entry)
+    trace_event(TRACE_TT, ply, depth, entry->flags, get_adjusted_score(ply, entry->score), entry->depth, entry->move);
+  else
+    trace_event(TRACE_TT, ply, depth, 0, 0, 0, 0);
   if (!is_pv && !excluded && entry && entry->depth >= depth) {
     const int tt_flags = entry->flags;
     const int tt_score = get_adjusted_score(ply, entry->score);
     if (tt_flags == TT_EXACT || (tt_flags == TT_BETA && tt_score >= beta) || (tt_flags == TT_ALPHA && tt_score <= alpha)) {
+      STAT_INC_D(tt_cutoffs, depth);
+      trace_event(TRACE_CUTOFF, ply, depth, TRACE_CUT_TT, tt_score, 0, 0);
       return tt_score;
     }
   }
@@ -108,8 +140,13 @@ if (search_local_node_batch >= 1024) {
 
   const int improving = !in_check && (ply < 2 || ev > nodes[ply-2].ev);
 
-  if (!is_pv && !excluded && !in_check && depth <= 8 && ev >= beta + (75 * (depth - improving))) {
-    return ev;
+  if (!is_pv && !excluded && !in_check && depth <= 8) {
+    STAT_INC(rfp_tries);
+    if (ev >= beta + (75 * (depth - improving))) {
+      STAT_INC(rfp_cutoffs);
+      trace_event(TRACE_CUTOFF, ply, depth, TRACE_CUT_RFP, ev, 0, 0);
+      return ev;
+    }
   }
 
   // =========================================================
@@ -120,8 +157,11 @@ if (search_local_node_batch >= 1024) {
   if (!is_pv && !excluded && !in_check && depth <= 3) {
     int razor_margin = 300 + (depth * 100);
     if (ev + razor_margin <= alpha) {
+      STAT_INC(razor_tries);
       int razor_score = qsearch(ply, alpha, alpha + 1);
       if (razor_score <= alpha) {
+        STAT_INC(razor_cutoffs);
+        trace_event(TRACE_CUTOFF, ply, depth, TRACE_CUT_RAZOR, razor_score, 0, 0);
         return razor_score;
       }
     }
@@ -138,7 +178,7 @@ if (search_local_node_batch >= 1024) {
     pos_copy(pos, next_pos);
     make_null_move(next_pos);
     tt_prefetch(next_pos->hash);
-    memcpy(next_node->accs, node->accs, sizeof(node->accs));
+    memcpy(next_node->accs, node->accs, sizeof(NodeAccs));
     next_node->accs_dirty = 0;
     next_node->cont_entry = NULL;
     
@@ -147,9 +187,13 @@ if (search_local_node_batch >= 1024) {
     next_node->prev_to = 0;
 
     const int score = -search(ply+1, nmp_depth, -beta, -beta+1);
+    STAT_INC(nmp_tries);
   
-    if (score >= beta)
+    if (score >= beta) {
+      STAT_INC(nmp_cutoffs);
+      trace_event(TRACE_CUTOFF, ply, depth, TRACE_CUT_NULL, score, 0, 0);
       return score > MATEISH ? beta : score;
+    }
   
     if (tc->finished)
       return 0;
@@ -161,7 +205,6 @@ if (search_local_node_batch >= 1024) {
   int score = 0;
   int best_score = -INF;
   int played = 0;
-  const uint64_t *next_stm_king_ptr = &next_pos->all[stm_king_idx];
   const int orig_alpha = alpha;
 
   init_next_search_move(node, in_check, tt_move);
@@ -190,6 +233,7 @@ if (search_local_node_batch >= 1024) {
 
       node->excluded_move = tt_move;
       const int s_score = search(ply, s_depth, s_beta - 1, s_beta);
+      STAT_INC(se_tries);
       node->excluded_move = 0;
       node->stage = 1;          
       node->tt_move = tt_move;  
@@ -201,35 +245,45 @@ if (search_local_node_batch >= 1024) {
         extension = 1;
         if (!is_pv && s_score < s_beta - 16 && node->dextensions <= 6)
           extension = 2;          
+        STAT_INC(se_single);
+        STAT_ADD(se_double, extension == 2);
       }
-      else if (s_beta >= beta)    
+      else if (s_beta >= beta) {
+        STAT_INC(se_multicut);
+        trace_event(TRACE_CUTOFF, ply, depth, TRACE_CUT_MULTICUT, s_beta, 0, tt_move);
         return s_beta;
-      else if (tt_score >= beta)  
+      }
+      else if (tt_score >= beta) {
+        STAT_INC(se_negative);
         extension = -1;
+      }
     }
 
     const int from = (move >> 6) & 0x3F;
     const int to = move & 0x3F;
     const int moved_piece = pos->board[from];
-    const int hist = is_quiet ? piece_to_history[moved_piece][to] : 0;
+    const int hist = is_quiet ? thread_hist->piece_to_history[moved_piece][to] : 0;
 
     pos_copy(pos, next_pos);
     make_move(next_node, move);
     tt_prefetch(next_pos->hash);
-    if (is_attacked(next_pos, bsf(*next_stm_king_ptr), opp))
-      continue;
 
     next_node->accs_dirty = 1;
-    next_node->cont_entry = cont_history[moved_piece][to];
+    next_node->cont_entry = thread_hist->cont_history[moved_piece][to];
     
     // Assign previous move traits to the child ply
     next_node->prev_piece = moved_piece;
     next_node->prev_to = to;
 
-    node->played[played++] = move;
+    if (played < MAX_PLAYED)
+      node->played[played] = move;
+    played++;
 
     const int new_depth = depth - 1 + extension;
 
+    if (extension)
+      trace_event(TRACE_EXTEND, ply, depth, 0, extension, 0, move);
+
     if (extension == 2)
       node->dextensions++;
 
@@ -248,9 +302,11 @@ if (search_local_node_batch >= 1024) {
           d = (d < 1) ? 1 : d;
         }
 
+        STAT_ADD(lmr_reduced, d < new_depth);
         score = -search(ply+1, d, -alpha-1, -alpha);
 
         if (!tc->finished && score > alpha) {
+          STAT_ADD(lmr_researches, d < new_depth);
           score = -search(ply+1, new_depth, -beta, -alpha);
         }
       }
@@ -266,9 +322,11 @@ if (search_local_node_batch >= 1024) {
         d = (d < 1) ? 1 : d;
       }
 
+      STAT_ADD(lmr_reduced, d < new_depth);
       score = -search(ply+1, d, -beta, -alpha);
 
       if (!tc->finished && score > alpha && d < new_depth) {
+        STAT_INC(lmr_researches);
         score = -search(ply+1, new_depth, -beta, -alpha);
       }
     }
@@ -292,6 +350,10 @@ if (search_local_node_batch >= 1024) {
           collect_pv(ply, best_move);
         }
         if (score >= beta) {
+
+          STAT_INC(fail_highs);
+          STAT_ADD(fail_highs_first, played == 1);
+          trace_event(TRACE_CUTOFF, ply, depth, TRACE_CUT_MOVE, score, played, move);
           
           // =========================================================
           // PAWNOCCHIO IDEA #1: STATSCORE HISTORY
@@ -306,11 +368,16 @@ if (search_local_node_batch >= 1024) {
             bonus = 2020;
           // =========================================================
           
-          for (int i=0; i < played; i++) {
+          // the moves tried before the cutoff, as many as were kept
+          const int tried = played - 1 < MAX_PLAYED ? played - 1 : MAX_PLAYED;
+
+          for (int i=0; i < tried; i++) {
             const move_t pm = node->played[i];
             if (pm & MOVE_FLAG_CAPTURE)
-              update_capture_history(pos, pm, pm == best_move ? bonus : -bonus);
+              update_capture_history(pos, pm, -bonus);
           }
+          if (best_move & MOVE_FLAG_CAPTURE)
+            update_capture_history(pos, best_move, bonus);
           if (!(best_move & (MOVE_FLAG_CAPTURE | MOVE_FLAG_PROMOTE))) {
             update_killer(node, best_move);
             update_piece_to_history(pos, best_move, bonus);
@@ -318,10 +385,10 @@ if (search_local_node_batch >= 1024) {
             
             // Update Countermove Table on cutoff
             if (ply > 0 && node->prev_piece != EMPTY) {
-              counter_moves[node->prev_piece][node->prev_to] = best_move;
+              thread_hist->counter_moves[node->prev_piece][node->prev_to] = best_move;
             }
 
-            for (int i=0; i < played-1; i++) {
+            for (int i=0; i < tried; i++) {
               const move_t pm = node->played[i];
               if (!(pm & (MOVE_FLAG_CAPTURE | MOVE_FLAG_PROMOTE))) {
                 update_piece_to_history(pos, pm, -bonus);
@@ -1,6 +1,8 @@
 #ifndef SEARCH_H
 #define SEARCH_H
 
+extern _Thread_local int search_local_node_batch;
+
 void init_lmr(void);
 int search(const int ply, int depth, int alpha, int beta);
 
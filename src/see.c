@@ -61,7 +61,7 @@ static uint64_t get_least_valuable_piece(const Position *const pos, const uint64
 static uint64_t rook_attackers_to(const Position *const pos, const uint64_t occ, const int to_sq) {
 
   const Attack *const restrict a = &rook_attacks[to_sq];
-  uint64_t rays                  = a->attacks[magic_index(occ & a->mask, a->magic, a->shift)];
+  uint64_t rays                  = slider_attacks(a, occ);
 
   return rays & (pos->all[ROOK] | pos->all[6+ROOK] | pos->all[QUEEN] | pos->all[6+QUEEN]);
 
@@ -70,7 +70,7 @@ static uint64_t rook_attackers_to(const Position *const pos, const uint64_t occ,
 static uint64_t bishop_attackers_to(const Position *const pos, const uint64_t occ, const int to_sq) {
 
   const Attack *const restrict a = &bishop_attacks[to_sq];
-  uint64_t rays                  = a->attacks[magic_index(occ & a->mask, a->magic, a->shift)];
+  uint64_t rays                  = slider_attacks(a, occ);
 
   return rays & (pos->all[BISHOP] | pos->all[6+BISHOP] | pos->all[QUEEN] | pos->all[6+QUEEN]);
 
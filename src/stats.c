@@ -0,0 +1,115 @@
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "stats.h"
+
+#ifdef STATS
+
+_Thread_local SearchStats search_stats;
+
+static SearchStats stats_total;
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static double pct(const uint64_t a, const uint64_t b) {
+
+  return b ? 100.0 * (double)a / (double)b : 0.0;
+
+}
+
+static double avg(const uint64_t a, const uint64_t b) {
+
+  return b ? (double)a / (double)b : 0.0;
+
+}
+
+// add this thread's counters to the totals; search threads call it when
+// they finish a go
+void stats_flush(void) {
+
+  const uint64_t *from = (const uint64_t *)&search_stats;
+  uint64_t *to = (uint64_t *)&stats_total;
+
+  pthread_mutex_lock(&stats_lock);
+  for (size_t i=0; i < sizeof(SearchStats) / sizeof(uint64_t); i++)
+    to[i] += from[i];
+  pthread_mutex_unlock(&stats_lock);
+
+  memset(&search_stats, 0, sizeof(SearchStats));
+
+}
+
+void stats_clear(void) {
+
+  pthread_mutex_lock(&stats_lock);
+  memset(&stats_total, 0, sizeof(SearchStats));
+  pthread_mutex_unlock(&stats_lock);
+
+}
+
+void stats_print(void) {
+
+  SearchStats s;
+
+  pthread_mutex_lock(&stats_lock);
+  s = stats_total;
+  pthread_mutex_unlock(&stats_lock);
+
+  const uint64_t all_nodes = s.search_nodes + s.qsearch_nodes;
+
+  printf("nodes %llu search %llu qsearch %llu (%.1f%%)\n",
+    (unsigned long long)all_nodes,
+    (unsigned long long)s.search_nodes,
+    (unsigned long long)s.qsearch_nodes,
+    pct(s.qsearch_nodes, all_nodes));
+
+  printf("%5s %12s %7s %7s\n", "depth", "tt probes", "hit%", "cut%");
+  for (int d=0; d < STATS_DEPTHS; d++) {
+    if (!s.tt_probes[d])
+      continue;
+    printf("%4d%s %12llu %7.1f %7.1f\n", d, d == STATS_DEPTHS - 1 ? "+" : " ",
+      (unsigned long long)s.tt_probes[d],
+      pct(s.tt_hits[d], s.tt_probes[d]),
+      pct(s.tt_cutoffs[d], s.tt_probes[d]));
+  }
+  printf("%5s %12llu %7.1f %7.1f\n", "qs",
+    (unsigned long long)s.qs_tt_probes,
+    pct(s.qs_tt_hits, s.qs_tt_probes),
+    pct(s.qs_tt_cutoffs, s.qs_tt_probes));
+
+  printf("fail high %llu first move %.1f%%\n", (unsigned long long)s.fail_highs, pct(s.fail_highs_first, s.fail_highs));
+  printf("rfp tries %llu cut %.1f%%\n", (unsigned long long)s.rfp_tries, pct(s.rfp_cutoffs, s.rfp_tries));
+  printf("razor tries %llu cut %.1f%%\n", (unsigned long long)s.razor_tries, pct(s.razor_cutoffs, s.razor_tries));
+  printf("null move tries %llu cut %.1f%%\n", (unsigned long long)s.nmp_tries, pct(s.nmp_cutoffs, s.nmp_tries));
+  printf("lmr reduced %llu re-search %.1f%%\n", (unsigned long long)s.lmr_reduced, pct(s.lmr_researches, s.lmr_reduced));
+
+  printf("singular tries %llu single %.1f%% double %.1f%% negative %.1f%% multicut %.1f%%\n",
+    (unsigned long long)s.se_tries,
+    pct(s.se_single, s.se_tries),
+    pct(s.se_double, s.se_tries),
+    pct(s.se_negative, s.se_tries),
+    pct(s.se_multicut, s.se_tries));
+
+  printf("picker tt moves %llu noisy %llu x %.2f quiet %llu x %.2f qsearch noisy %llu x %.2f evasions %llu x %.2f\n",
+    (unsigned long long)s.tt_moves,
+    (unsigned long long)s.noisy_gens, avg(s.noisy_moves, s.noisy_gens),
+    (unsigned long long)s.quiet_gens, avg(s.quiet_moves, s.quiet_gens),
+    (unsigned long long)s.qs_noisy_gens, avg(s.qs_noisy_moves, s.qs_noisy_gens),
+    (unsigned long long)s.evasion_gens, avg(s.evasion_moves, s.evasion_gens));
+
+}
+
+#else
+
+void stats_flush(void) {
+}
+
+void stats_clear(void) {
+}
+
+void stats_print(void) {
+
+  printf("stats: not counted in this build, use make stats\n");
+
+}
+
+#endif
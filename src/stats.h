@@ -0,0 +1,78 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+
+// search statistics for tuning, only counted in a -DSTATS build (make stats);
+// the macros compile to nothing otherwise
+
+#define STATS_DEPTHS 32
+
+typedef struct {
+
+  uint64_t search_nodes;
+  uint64_t qsearch_nodes;
+
+  uint64_t tt_probes[STATS_DEPTHS];
+  uint64_t tt_hits[STATS_DEPTHS];
+  uint64_t tt_cutoffs[STATS_DEPTHS];
+  uint64_t qs_tt_probes;
+  uint64_t qs_tt_hits;
+  uint64_t qs_tt_cutoffs;
+
+  uint64_t fail_highs;
+  uint64_t fail_highs_first;
+
+  uint64_t rfp_tries;
+  uint64_t rfp_cutoffs;
+  uint64_t razor_tries;
+  uint64_t razor_cutoffs;
+  uint64_t nmp_tries;
+  uint64_t nmp_cutoffs;
+
+  uint64_t lmr_reduced;
+  uint64_t lmr_researches;
+
+  uint64_t se_tries;
+  uint64_t se_single;
+  uint64_t se_double;
+  uint64_t se_negative;
+  uint64_t se_multicut;
+
+  uint64_t tt_moves;
+  uint64_t noisy_gens;
+  uint64_t noisy_moves;
+  uint64_t quiet_gens;
+  uint64_t quiet_moves;
+  uint64_t qs_noisy_gens;
+  uint64_t qs_noisy_moves;
+  uint64_t evasion_gens;
+  uint64_t evasion_moves;
+
+} SearchStats;
+
+#ifdef STATS
+
+extern _Thread_local SearchStats search_stats;
+
+#define STAT_INC(f)        (search_stats.f++)
+#define STAT_ADD(f, n)     (search_stats.f += (uint64_t)(n))
+#define STAT_INC_D(f, d)   (search_stats.f[(d) < STATS_DEPTHS ? (d) : STATS_DEPTHS - 1]++)
+#define STAT_ADD_D(f, d, n) (search_stats.f[(d) < STATS_DEPTHS ? (d) : STATS_DEPTHS - 1] += (uint64_t)(n))
+#define STAT_FLUSH()       stats_flush()
+
+#else
+
+#define STAT_INC(f)         ((void)0)
+#define STAT_ADD(f, n)      ((void)0)
+#define STAT_INC_D(f, d)    ((void)0)
+#define STAT_ADD_D(f, d, n) ((void)0)
+#define STAT_FLUSH()        ((void)0)
+
+#endif
+
+void stats_flush(void);
+void stats_clear(void);
+void stats_print(void);
+
+#endif
@@ -3,13 +3,14 @@
 #include "move.h"
 #include "nodes.h"
 #include "input.h"
+#include "trace.h"
 
 TimeControl time_control;
-static volatile int input_lock = 0;
+_Thread_local TimeControl *thread_tc = &time_control;
 
 void init_tc(int64_t wtime, int64_t winc, int64_t btime, int64_t binc, int64_t max_nodes, int64_t move_time, int max_depth, int moves_to_go) {
 
-  TimeControl *tc = &time_control;
+  TimeControl *tc = thread_tc;
 
   if (wtime < 0) wtime = 0;
   if (winc < 0) winc = 0;
@@ -60,12 +61,13 @@ void init_tc(int64_t wtime, int64_t winc, int64_t btime, int64_t binc, int64_t m
   tc->nodes = 0;
   tc->best_move = 0;
   tc->best_score = 0;
+  tc->depth = 0;
 
 }
 
 void check_tc(void) {
 
-  TimeControl *tc = &time_control;
+  TimeControl *tc = thread_tc;
 
   if (tc->finished)
     return;
@@ -90,7 +92,7 @@ void check_tc(void) {
 
 void check_tc_nodes(void) {
 
-  TimeControl *tc = &time_control;
+  TimeControl *tc = thread_tc;
   
   if (tc->finished)
     return;
@@ -99,13 +101,15 @@ void check_tc_nodes(void) {
   // THE FIX: Atomic Spinlock
   // Only 1 thread gets inside this block at a time. The rest
   // skip it and go straight back to searching at full speed!
-  if (__sync_lock_test_and_set(&input_lock, 1) == 0) {
+  if (__sync_lock_test_and_set(&tc->check_lock, 1) == 0) {
 
     // 1. Check time limit
     if (tc->finish_time) {
-      if (time_ms() >= tc->finish_time) {
+      const uint64_t now = time_ms();
+      if (now >= tc->finish_time) {
         tc->finished = 1;
       }
+      trace_event(TRACE_TIME, 0, 127, tc->finished, 0, 0, (uint32_t)(now - tc->start_time));
     }
 
     // 2. Check hard node limit
@@ -116,7 +120,7 @@ void check_tc_nodes(void) {
     }
 
     // Unlock so it can be checked again later
-    __sync_lock_release(&input_lock);
+    __sync_lock_release(&tc->check_lock);
   }
   // ========================================================
 
@@ -14,13 +14,15 @@ typedef struct {
   uint64_t hard_nodes;
   move_t best_move;
   int best_score;
+  int depth;  // last iteration thread 0 completed
   _Atomic uint64_t nodes;
   _Atomic int finished;
-
+  volatile int check_lock;  // one thread at a time checks the clock
 
 } TimeControl;
 
-extern TimeControl time_control;
+extern TimeControl time_control;           // uci instance
+extern _Thread_local TimeControl *thread_tc;  // &time_control unless the thread owns one (datagen)
 
 void init_tc(int64_t wtime, int64_t winc, int64_t btime, int64_t binc, int64_t max_nodes, int64_t move_time, int max_depth, int moves_to_go);
 void check_tc(void);
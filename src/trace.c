@@ -0,0 +1,343 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "trace.h"
+#include "timecontrol.h"
+#include "move.h"
+
+#define TRACE_MAX_THREADS 256
+
+_Thread_local TraceRing *trace_ring = NULL;
+int trace_enabled = 0;
+
+static TraceRing rings[TRACE_MAX_THREADS];
+static int trace_threads = 0;  // threads in the last traced go
+static uint64_t trace_events = TRACE_DEFAULT_EVENTS;
+static int trace_min_depth = 0;
+static char trace_file[1024] = TRACE_DEFAULT_FILE;
+
+// a ring that records nothing and hands every node to a sampler instead
+static _Thread_local TraceRing sample_ring = {NULL, 0, 0, INT_MAX, NULL};
+
+static const char *const type_names[TRACE_TYPES] = {"enter", "exit", "tt", "cut", "ext", "time"};
+static const char *const cut_names[] = {"move", "tt", "rfp", "razor", "null", "multicut"};
+
+// point the calling search thread at its ring, emptied for this go; a
+// negative id (private searches such as datagen workers) is not traced
+void trace_thread_start(const int thread_id) {
+
+  trace_ring = sample_ring.sample ? &sample_ring : NULL;
+
+  if (trace_ring || !trace_enabled || thread_id < 0 || thread_id >= TRACE_MAX_THREADS)
+    return;
+
+  TraceRing *r = &rings[thread_id];
+
+  if (!r->events) {
+    r->events = malloc(trace_events * sizeof(TraceEvent));
+    if (!r->events)
+      return;
+    r->mask = trace_events - 1;
+  }
+
+  r->head = 0;
+  r->min_depth = trace_min_depth;
+  trace_ring = r;
+
+}
+
+// searches started from the calling thread call fn at every search node
+// instead of tracing, until trace_sample(NULL); the microbench records its
+// stream this way
+void trace_sample(TraceSampler fn) {
+
+  sample_ring.sample = fn;
+
+}
+
+void trace_record(TraceRing *r, const int type, const int ply, const int depth, const int flags, const int a, const int b, const uint32_t move) {
+
+  TraceEvent *e = &r->events[r->head++ & r->mask];
+
+  e->type = (uint8_t)type;
+  e->ply = (uint8_t)ply;
+  e->depth = (int8_t)(depth > 127 ? 127 : depth);
+  e->flags = (uint8_t)flags;
+  e->a = (int16_t)a;
+  e->b = (int16_t)b;
+  e->move = move;
+  e->nodes = (uint32_t)thread_tc->nodes;
+
+}
+
+static void trace_free(void) {
+
+  for (int i=0; i < TRACE_MAX_THREADS; i++) {
+    free(rings[i].events);
+    memset(&rings[i], 0, sizeof(TraceRing));
+  }
+
+  trace_threads = 0;
+
+}
+
+// magic, event size and ring count, then per ring its thread id, the
+// number of events written and the newest ones that survived, oldest first
+static int trace_save(const char *path) {
+
+  FILE *f = fopen(path, "wb");
+  uint32_t num = 0;
+
+  if (!f) {
+    printf("error: cannot create %s\n", path);
+    return 1;
+  }
+
+  for (int i=0; i < trace_threads; i++)
+    num += rings[i].events != NULL;
+
+  const uint32_t size = sizeof(TraceEvent);
+
+  fwrite(TRACE_MAGIC, 1, 8, f);
+  fwrite(&size, sizeof(size), 1, f);
+  fwrite(&num, sizeof(num), 1, f);
+
+  for (uint32_t i=0; i < (uint32_t)trace_threads; i++) {
+
+    const TraceRing *r = &rings[i];
+
+    if (!r->events)
+      continue;
+
+    const uint64_t cap = r->mask + 1;
+    const uint64_t count = r->head < cap ? r->head : cap;
+    const uint64_t first = r->head - count;
+
+    fwrite(&i, sizeof(i), 1, f);
+    fwrite(&r->head, sizeof(r->head), 1, f);
+    fwrite(&count, sizeof(count), 1, f);
+
+    // the surviving events are at most two contiguous runs of the ring
+    const uint64_t start = first & r->mask;
+    const uint64_t run = count < cap - start ? count : cap - start;
+
+    fwrite(&r->events[start], sizeof(TraceEvent), run, f);
+    fwrite(r->events, sizeof(TraceEvent), count - run, f);
+
+  }
+
+  const int err = ferror(f);
+
+  if (fclose(f) || err) {
+    printf("error: cannot write %s\n", path);
+    return 1;
+  }
+
+  return 0;
+
+}
+
+// called by go once its threads have joined
+void trace_write_go(const int threads) {
+
+  if (!trace_enabled)
+    return;
+
+  trace_threads = threads < TRACE_MAX_THREADS ? threads : TRACE_MAX_THREADS;
+  trace_save(trace_file);
+
+}
+
+// trace <min depth> [events] [file] | off | save [file]
+void trace_command(int ntokens, char **tokens) {
+
+  if (ntokens < 2) {
+    if (trace_enabled)
+      printf("trace: on min depth %d events %llu file %s\n", trace_min_depth, (unsigned long long)trace_events, trace_file);
+    else
+      printf("trace: off\n");
+    return;
+  }
+
+  if (!strcmp(tokens[1], "off")) {
+    trace_enabled = 0;
+    trace_free();
+    return;
+  }
+
+  if (!strcmp(tokens[1], "save")) {
+    if (trace_save(ntokens > 2 ? tokens[2] : trace_file) == 0)
+      printf("trace: saved %s\n", ntokens > 2 ? tokens[2] : trace_file);
+    return;
+  }
+
+  uint64_t events = ntokens > 2 ? strtoull(tokens[2], NULL, 10) : TRACE_DEFAULT_EVENTS;
+
+  if (events < 1024)
+    events = 1024;
+
+  // the ring index is a mask
+  while (events & (events - 1))
+    events &= events - 1;
+
+  trace_free();
+  trace_min_depth = atoi(tokens[1]);
+  trace_events = events;
+  if (ntokens > 3) {
+    strncpy(trace_file, tokens[3], sizeof(trace_file) - 1);
+    trace_file[sizeof(trace_file) - 1] = 0;
+  }
+  trace_enabled = 1;
+
+  printf("trace: on min depth %d events %llu file %s\n", trace_min_depth, (unsigned long long)trace_events, trace_file);
+
+}
+
+// uci move, or - where the event has none
+static void trace_move(const TraceEvent *e, char *m) {
+
+  if (e->type == TRACE_TIME || !e->move)
+    strcpy(m, "-");
+  else
+    format_move(e->move, m);
+
+}
+
+static void dump_csv(const TraceEvent *e, const uint32_t thread, const uint64_t index) {
+
+  char m[6];
+
+  trace_move(e, m);
+
+  printf("%u,%llu,%s,%d,%d,%d,%d,%d,%s,%u\n",
+    thread, (unsigned long long)index,
+    e->type < TRACE_TYPES ? type_names[e->type] : "?",
+    e->ply, e->depth, e->flags, e->a, e->b,
+    m,
+    e->nodes);
+
+}
+
+static void dump_tree(const TraceEvent *e, const int base_ply) {
+
+  char m[6];
+  const int indent = e->ply > base_ply ? 2 * (e->ply - base_ply) : 0;
+
+  trace_move(e, m);
+  printf("%*s", indent, "");
+
+  switch (e->type) {
+
+    case TRACE_ENTER:
+      printf("> ply %d d %d [%d, %d] n %u\n", e->ply, e->depth, e->a, e->b, e->nodes);
+      break;
+
+    case TRACE_EXIT:
+      printf("< ply %d d %d score %d\n", e->ply, e->depth, e->a);
+      break;
+
+    case TRACE_TT:
+      if (e->flags)
+        printf("tt %s d %d score %d move %s\n",
+          e->flags == 1 ? "exact" : e->flags == 2 ? "upper" : "lower", e->b, e->a, m);
+      else
+        printf("tt miss\n");
+      break;
+
+    case TRACE_CUTOFF:
+      printf("cut %s score %d", e->flags < 6 ? cut_names[e->flags] : "?", e->a);
+      if (e->flags == TRACE_CUT_MOVE)
+        printf(" move %s played %d", m, e->b);
+      printf("\n");
+      break;
+
+    case TRACE_EXTEND:
+      printf("ext %+d move %s\n", e->a, m);
+      break;
+
+    case TRACE_TIME:
+      printf("time %u ms%s n %u\n", e->move, e->flags ? " finished" : "", e->nodes);
+      break;
+
+    default:
+      printf("? type %d\n", e->type);
+
+  }
+
+}
+
+// decode a trace file as csv or an indented tree; thread < 0 is all
+void tracedump(const char *path, const char *format, int thread) {
+
+  FILE *f = fopen(path, "rb");
+  char magic[8];
+  uint32_t size = 0, num = 0;
+  const int tree = format && !strcmp(format, "tree");
+
+  if (!f) {
+    printf("error: cannot open %s\n", path);
+    return;
+  }
+
+  if (fread(magic, 1, 8, f) != 8 || memcmp(magic, TRACE_MAGIC, 8) ||
+      fread(&size, sizeof(size), 1, f) != 1 || size != sizeof(TraceEvent) ||
+      fread(&num, sizeof(num), 1, f) != 1) {
+    printf("error: %s is not a trace file\n", path);
+    fclose(f);
+    return;
+  }
+
+  if (!tree)
+    printf("thread,index,type,ply,depth,flags,a,b,move,nodes\n");
+
+  for (uint32_t i=0; i < num; i++) {
+
+    uint32_t id;
+    uint64_t head, count;
+    TraceEvent e;
+    int base_ply = 255;
+
+    if (fread(&id, sizeof(id), 1, f) != 1 || fread(&head, sizeof(head), 1, f) != 1 || fread(&count, sizeof(count), 1, f) != 1) {
+      printf("error: %s is truncated\n", path);
+      break;
+    }
+
+    const long start = ftell(f);
+    const int wanted = thread < 0 || (uint32_t)thread == id;
+
+    if (wanted && tree) {
+
+      // indent from the shallowest ply that survived in the ring
+      for (uint64_t k=0; k < count && fread(&e, sizeof(e), 1, f) == 1; k++)
+        if (e.ply < base_ply)
+          base_ply = e.ply;
+
+      fseek(f, start, SEEK_SET);
+      printf("thread %u events %llu kept %llu\n", id, (unsigned long long)head, (unsigned long long)count);
+
+    }
+
+    for (uint64_t k=0; k < count; k++) {
+
+      if (fread(&e, sizeof(e), 1, f) != 1) {
+        printf("error: %s is truncated\n", path);
+        fclose(f);
+        return;
+      }
+
+      if (!wanted)
+        continue;
+
+      if (tree)
+        dump_tree(&e, base_ply);
+      else
+        dump_csv(&e, id, head - count + k);
+
+    }
+
+  }
+
+  fclose(f);
+
+}
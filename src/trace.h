@@ -0,0 +1,77 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+// search flight recorder; when enabled each search thread writes compact
+// events into its own ring and the newest ones are saved after every go
+
+#define TRACE_MAGIC "cwtrace1"
+#define TRACE_DEFAULT_EVENTS (1 << 20)
+#define TRACE_DEFAULT_FILE "cwtch.trace"
+
+enum {
+  TRACE_ENTER,   // a, b = alpha, beta
+  TRACE_EXIT,    // a = score
+  TRACE_TT,      // flags = tt flags (0 miss), a = tt score, b = tt depth, move = tt move
+  TRACE_CUTOFF,  // flags = TRACE_CUT_*, a = score, b = moves played, move = cutoff move
+  TRACE_EXTEND,  // a = extension, move = extended move
+  TRACE_TIME,    // flags = finished, move = elapsed ms
+  TRACE_TYPES
+};
+
+enum {
+  TRACE_CUT_MOVE,
+  TRACE_CUT_TT,
+  TRACE_CUT_RFP,
+  TRACE_CUT_RAZOR,
+  TRACE_CUT_NULL,
+  TRACE_CUT_MULTICUT
+};
+
+typedef struct {
+
+  uint8_t type;
+  uint8_t ply;
+  int8_t depth;
+  uint8_t flags;
+  int16_t a;
+  int16_t b;
+  uint32_t move;
+  uint32_t nodes;  // tc nodes when recorded, flushed in batches of 1024
+
+} TraceEvent;
+
+typedef void (*TraceSampler)(const int ply, const int depth);
+
+typedef struct {
+
+  TraceEvent *events;
+  uint64_t head;  // events ever written this go
+  uint64_t mask;
+  int min_depth;
+  TraceSampler sample;  // called on every search node entered, or NULL
+
+} TraceRing;
+
+extern _Thread_local TraceRing *trace_ring;  // NULL unless tracing
+extern int trace_enabled;
+
+void trace_thread_start(const int thread_id);
+void trace_sample(TraceSampler fn);
+void trace_write_go(const int threads);
+void trace_command(int ntokens, char **tokens);
+void tracedump(const char *path, const char *format, int thread);
+void trace_record(TraceRing *r, const int type, const int ply, const int depth, const int flags, const int a, const int b, const uint32_t move);
+
+// one test of a thread local when tracing is off
+static inline void trace_event(const int type, const int ply, const int depth, const int flags, const int a, const int b, const uint32_t move) {
+
+  TraceRing *r = trace_ring;
+
+  if (r && depth >= r->min_depth)
+    trace_record(r, type, ply, depth, flags, a, b, move);
+
+}
+
+#endif
@@ -19,38 +19,68 @@ typedef struct {
   volatile int flags;
 } InternalTT;
 
-static InternalTT *tt = NULL;
-static size_t tt_entries = 0;
-static size_t tt_mask    = 0;
+struct TTable {
+  InternalTT *entries;
+  size_t count;
+  size_t mask;
+};
+
+static TTable tt_shared;
+_Thread_local TTable *thread_tt = &tt_shared;
 
 _Thread_local TT unpacked_tt;
 
-int new_tt(size_t megabytes) {
+static int tt_alloc(TTable *t, size_t megabytes) {
   if (megabytes < 1) megabytes = 1;
   if (megabytes > 32768) megabytes = 32768;
 
-  if (tt) {
-    free(tt);
-    tt = NULL;
+  if (t->entries) {
+    free(t->entries);
+    t->entries = NULL;
   }
 
   const size_t bytes = megabytes * 1024ULL * 1024ULL;
-  tt_entries = bytes / sizeof(InternalTT);
-  tt_entries = 1ULL << (63 - __builtin_clzll(tt_entries));
-  tt_mask    = tt_entries - 1;
-  tt         = calloc(tt_entries, sizeof(InternalTT));
+  t->count   = bytes / sizeof(InternalTT);
+  t->count   = 1ULL << (63 - __builtin_clzll(t->count));
+  t->mask    = t->count - 1;
+  t->entries = calloc(t->count, sizeof(InternalTT));
+
+  return t->entries == NULL;
+}
+
+int new_tt(size_t megabytes) {
+  TTable *t = thread_tt;
 
-  if (!tt) {
+  if (tt_alloc(t, megabytes)) {
     printf("info string failed to allocate tt\n");
     return 1;
   }
 
-  printf("info string tt entries %zu (%zu MB)\n", tt_entries, (tt_entries * sizeof(InternalTT)) / 1024 / 1024);
+  printf("info string tt entries %zu (%zu MB)\n", t->count, (t->count * sizeof(InternalTT)) / 1024 / 1024);
   return 0;
 }
 
+// private table for a thread that searches on its own (datagen workers)
+TTable *tt_new_private(size_t megabytes) {
+  TTable *t = calloc(1, sizeof(TTable));
+  if (!t)
+    return NULL;
+  if (tt_alloc(t, megabytes)) {
+    free(t);
+    return NULL;
+  }
+  return t;
+}
+
+void tt_free_private(TTable *t) {
+  if (!t || t == &tt_shared)
+    return;
+  free(t->entries);
+  free(t);
+}
+
 void tt_clear(void) {
-  memset(tt, 0, tt_entries * sizeof(*tt));
+  memset(thread_tt->entries, 0, thread_tt->count * sizeof(InternalTT));
 }
 
 int put_adjusted_score(const int ply, const int score) {
@@ -66,8 +96,8 @@ int get_adjusted_score(const int ply, const int score) {
 }
 
 void tt_put(const Position *pos, const int flags, const int depth, const int score, const move_t move) {
-  const size_t idx = pos->hash & tt_mask;
-  InternalTT *entry = &tt[idx];
+  const TTable *t = thread_tt;
+  InternalTT *entry = &t->entries[pos->hash & t->mask];
 
   if (entry->flags && entry->key == pos->hash && entry->depth > depth)
     return;
@@ -97,12 +127,13 @@ void tt_put(const Position *pos, const int flags, const int depth, const int sco
 }
 
 void tt_prefetch(const uint64_t hash) {
-  __builtin_prefetch(&tt[hash & tt_mask]);
+  const TTable *t = thread_tt;
+  __builtin_prefetch(&t->entries[hash & t->mask]);
 }
 
 TT *tt_get(const Position *pos) {
-  const size_t idx = pos->hash & tt_mask;
-  InternalTT *entry = &tt[idx];
+  const TTable *t = thread_tt;
+  InternalTT *entry = &t->entries[pos->hash & t->mask];
 
   uint32_t seq;
   int attempts = 0;
@@ -141,7 +172,7 @@ TT *tt_get(const Position *pos) {
 }
 
 void new_game(void) {
-  if (!tt) new_tt(TT_DEFAULT_MB);
+  if (!thread_tt->entries) new_tt(TT_DEFAULT_MB);
   tt_clear();
   clear_piece_to_history();
   clear_cont_history();
@@ -151,5 +182,5 @@ void new_game(void) {
 }
 
 int is_tt_null() {
-  return (int)(tt == NULL);
+  return (int)(thread_tt->entries == NULL);
 }
\ No newline at end of file
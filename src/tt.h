@@ -21,7 +21,13 @@ typedef struct {
 
 } TT;
 
+typedef struct TTable TTable;
+
+extern _Thread_local TTable *thread_tt;  // shared uci table unless the thread owns one
+
 int new_tt(size_t megabytes);
+TTable *tt_new_private(size_t megabytes);
+void tt_free_private(TTable *t);
 void tt_clear(void); 
 int is_tt_null();
 void new_game(void);
@@ -63,12 +63,30 @@ inline int piece_type(const int index) {
   static inline uint64_t time_ms(void) {
     return (uint64_t)GetTickCount64();
   }
+  static inline uint64_t time_us(void) {
+    LARGE_INTEGER f, c;
+    QueryPerformanceFrequency(&f);
+    QueryPerformanceCounter(&c);
+    return (uint64_t)(c.QuadPart / f.QuadPart) * 1000000 + (uint64_t)(c.QuadPart % f.QuadPart) * 1000000 / f.QuadPart;
+  }
+  static inline void sleep_ms(const unsigned ms) {
+    Sleep(ms);
+  }
 #else
   static inline uint64_t time_ms(void) {
     struct timespec ts;
     clock_gettime(CLOCK_MONOTONIC, &ts);
     return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
   }
+  static inline uint64_t time_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+  }
+  static inline void sleep_ms(const unsigned ms) {
+    struct timespec ts = {ms / 1000, (long)(ms % 1000) * 1000000L};
+    nanosleep(&ts, NULL);
+  }
 #endif
 
 #endif
\ No newline at end of file
@@ -14,9 +14,17 @@
 #include "evaluate.h"
 #include "net.h"
 #include "bench.h"
+#include "microbench.h"
+#include "stats.h"
+#include "trace.h"
 #include "tt.h"
 #include "input.h"
 #include "datagen.h"
+#include "vfstat.h"
+#include "rescore.h"
+#include "binpack.h"
+#include "vffilter.h"
+#include "bitboard.h"
 
 #define MAX_TOKENS 1024
 
@@ -190,19 +198,19 @@ bool uci_exec(char *input) {
     printf("eval: %d cp (white POV)\n", score);
   }
   
-  else if (str_eq(cmd, "perft", "f")) {
+  else if (str_eq(cmd, "perft", "f") || str_eq(cmd, "divide", "dv")) {
     int depth = (ntokens > 1) ? atoi(tokens[1]) : 1;
-    clock_t start = clock();
-    uint64_t num_nodes = perft(depth, 0);
-    clock_t end = clock();
-    double secs = (double)(end - start) / CLOCKS_PER_SEC;
+    int threads = (ntokens > 2) ? atoi(tokens[2]) : 1;
+    int hash_mb = (ntokens > 3) ? atoi(tokens[3]) : 0;
+    uint64_t start = time_ms();
+    uint64_t num_nodes = perft_root(depth, threads, hash_mb, str_eq(cmd, "divide", "dv"));
+    double secs = (time_ms() - start) / 1000.0;
     uint64_t nps = secs > 0 ? (uint64_t)(num_nodes / secs) : 0;
     printf("perft %d: %lu (%.3fs, %lu nps)\n", depth, num_nodes, secs, nps);
   }
-
   else if (str_eq(cmd, "pt", "")) {
     int max_depth = (ntokens > 1) ? atoi(tokens[1]) : 0;
-    perft_tests(max_depth);
+    perft_tests(max_depth, (ntokens > 2) ? atoi(tokens[2]) : 1, (ntokens > 3) ? atoi(tokens[3]) : 0);
   }
 
   else if (str_eq(cmd, "et", "")) {
@@ -226,18 +234,123 @@ bool uci_exec(char *input) {
   }
 
   else if (str_eq(cmd, "bench", "h")) {
+    if (ntokens > 1 && !strcmp(tokens[1], "scale")) {
+      int depth = (ntokens > 2) ? atoi(tokens[2]) : 10;
+      bench_scale(depth, (ntokens > 3) ? atoi(tokens[3]) : 0, (ntokens > 4) ? atoi(tokens[4]) : 0);
+      return true;
+    }
+    if (ntokens > 1 && !strcmp(tokens[1], "json")) {
+      int depth = (ntokens > 2) ? atoi(tokens[2]) : 10;
+      bench_json(depth, (ntokens > 3) ? atoi(tokens[3]) : 5, (ntokens > 4) ? tokens[4] : NULL);
+      return true;
+    }
     int depth = 10;
     if (ntokens > 1)
       depth = atoi(tokens[1]);
-    bench(depth);
+    bench(depth, (ntokens > 2) ? atoi(tokens[2]) : 0, (ntokens > 3) ? atoi(tokens[3]) : 0);
+  }
+
+  else if (str_eq(cmd, "startup", "")) {
+    bench_startup((ntokens > 1) ? atoi(tokens[1]) : 0);
+  }
+
+  else if (str_eq(cmd, "sliders", "")) {
+    printf("sliders: %s\n", use_pext ? "pext" : "magic");
+  }
+
+  else if (str_eq(cmd, "microbench", "mb")) {
+    const char *component = (ntokens > 1 && strcmp(tokens[1], "all")) ? tokens[1] : NULL;
+    microbench(component, (ntokens > 2) ? atoi(tokens[2]) : 0, 0);
+  }
+
+  else if (str_eq(cmd, "profile", "pf")) {
+    if (ntokens > 1 && str_eq(tokens[1], "microbench", "mb")) {
+      const char *component = (ntokens > 2 && strcmp(tokens[2], "all")) ? tokens[2] : NULL;
+      microbench(component, (ntokens > 3) ? atoi(tokens[3]) : 0, 1);
+    }
+    else if (ntokens > 1 && str_eq(tokens[1], "bench", "h")) {
+      bench_profile((ntokens > 2) ? atoi(tokens[2]) : 10, (ntokens > 3) ? atoi(tokens[3]) : 0);
+    }
+    else {
+      printf("usage: profile bench [depth] [threads]\n");
+      printf("       profile microbench [component|all] [ms]\n");
+    }
+  }
+
+  else if (str_eq(cmd, "stats", "")) {
+    if (ntokens > 1 && !strcmp(tokens[1], "clear"))
+      stats_clear();
+    else
+      stats_print();
+  }
+
+  else if (str_eq(cmd, "trace", "")) {
+    trace_command(ntokens, tokens);
+  }
+
+  else if (str_eq(cmd, "tracedump", "td")) {
+    if (ntokens < 2) {
+      printf("usage: tracedump <file> [csv|tree] [thread]\n");
+      return true;
+    }
+    tracedump(tokens[1], (ntokens > 2) ? tokens[2] : "csv", (ntokens > 3) ? atoi(tokens[3]) : -1);
   }
 
   else if (str_eq(cmd, "datagen", "dg")) {
     if (ntokens < 3) {
-      printf("usage: datagen <directory> <positions>\n");
+      printf("usage: datagen <directory> <positions> [threads] [name=value ...]\n");
+      printf("       datagen <directory> resume\n");
+      return true;
+    }
+    if (!strcmp(tokens[2], "resume")) {
+      datagen_resume(tokens[1]);
+      return true;
+    }
+    int threads = (ntokens > 3) ? atoi(tokens[3]) : 1;
+    int num_opts = (ntokens > 4) ? ntokens - 4 : 0;
+    datagen(tokens[1], (uint64_t)atof(tokens[2]), threads, num_opts, &tokens[4]);
+  }
+
+  else if (str_eq(cmd, "vfstat", "vs")) {
+    if (ntokens < 2) {
+      printf("usage: vfstat <directory|file> [threads]\n");
+      return true;
+    }
+    vfstat(tokens[1], (ntokens > 2) ? atoi(tokens[2]) : 1);
+  }
+
+  else if (str_eq(cmd, "rescore", "rs")) {
+    if (ntokens < 4) {
+      printf("usage: rescore <in.vf> <out.vf> <nodes> [threads]\n");
+      return true;
+    }
+    rescore(tokens[1], tokens[2], (int64_t)atof(tokens[3]), (ntokens > 4) ? atoi(tokens[4]) : 1);
+  }
+
+  else if (str_eq(cmd, "vfpack", "vp")) {
+    if (ntokens < 3) {
+      printf("usage: vfpack <in.vf> <out.cbp>\n");
+      return true;
+    }
+    binpack_file(tokens[1], tokens[2]);
+  }
+
+  else if (str_eq(cmd, "vfunpack", "vu")) {
+    if (ntokens < 3) {
+      printf("usage: vfunpack <in.cbp> <out.vf>\n");
+      return true;
+    }
+    unbinpack_file(tokens[1], tokens[2]);
+  }
+
+  else if (str_eq(cmd, "vffilter", "vx")) {
+    if (ntokens < 3) {
+      printf("usage: vffilter <directory|file> <out directory> [threads] [name=value ...]\n");
       return true;
     }
-    datagen(tokens[1], (uint64_t)atof(tokens[2]));
+    int threads = (ntokens > 3) ? atoi(tokens[3]) : 1;
+    int num_opts = (ntokens > 4) ? ntokens - 4 : 0;
+    vffilter(tokens[1], tokens[2], threads, num_opts, &tokens[4]);
   }
 
   else {
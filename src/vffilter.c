@@ -0,0 +1,648 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "vffilter.h"
+#include "types.h"
+#include "builtins.h"
+#include "pos.h"
+#include "move.h"
+#include "makemove.h"
+#include "mapfile.h"
+#include "viri.h"
+
+#define VFF_MAX_THREADS   256
+#define VFF_MAX_SHARDS    4096
+#define VFF_CHUNK_GAMES   4096
+#define VFF_SHARD_BUF     (1 << 20)  // per shard, flushed when full
+#define VFF_BLOOM_PROBES  4
+#define VFF_BLOOM_BITS    16    // per input position when sized automatically
+#define VFF_BLOOM_WARN    0.01  // expected false duplicate rate worth a warning
+#define VFF_MAX_GAME      (VIRI_BOARD_BYTES + 1025 * VIRI_MOVE_BYTES)
+
+// defaults, each can be changed with name=value
+#define VFF_DEDUPE        1
+#define VFF_DROP_CHECK    1
+#define VFF_DROP_TACTICAL 1
+#define VFF_MAX_SCORE     10000
+#define VFF_BLOOM_MB      0     // 0 = size from the input
+#define VFF_SHARDS        16
+
+enum {DROP_DUPLICATE, DROP_CHECK, DROP_TACTICAL, DROP_SCORE, DROP_BAD, NUM_DROPS};
+
+static const char *drop_names[NUM_DROPS] = {"duplicate", "check", "tactical", "score", "unreplayable"};
+
+typedef struct {
+  int dedupe;
+  int drop_check;
+  int drop_tactical;
+  int max_score;
+  int bloom_mb;
+  int shards;
+  uint64_t seed;
+} VffConfig;
+
+typedef struct {
+  int file;
+  size_t begin;
+  size_t end;
+} VffChunk;
+
+typedef struct {
+  FILE *fp;
+  uint8_t *buf;
+  size_t len;
+  pthread_mutex_t lock;
+} VffShard;
+
+typedef struct {
+  VffConfig cfg;
+  char **names;
+  MappedFile *files;
+  int num_files;
+  _Atomic int next_file;
+  _Atomic uint64_t num_positions;  // in the input, counted by the scan
+  VffChunk *chunks;
+  int num_chunks;
+  int cap_chunks;
+  _Atomic int next_chunk;
+  pthread_mutex_t chunk_lock;
+  _Atomic uint64_t *bloom;
+  uint64_t bloom_mask;  // in bits
+  VffShard *shards;
+  _Atomic int next_shard;
+  const char *out_dir;
+} VffShared;
+
+typedef struct {
+  VffShared *shared;
+  int id;
+  uint64_t rng;
+  uint64_t games;
+  uint64_t positions;
+  uint64_t kept;
+  uint64_t runs;
+  uint64_t dropped[NUM_DROPS];
+} VffWorker;
+
+static uint64_t vff_rand(uint64_t *s) {
+  *s ^= *s >> 12;
+  *s ^= *s << 25;
+  *s ^= *s >> 27;
+  return *s * 2685821657736338717ULL;
+}
+
+// --- options ---
+
+static int vff_set_option(VffConfig *cfg, char *opt) {
+
+  char *eq = strchr(opt, '=');
+  if (!eq) {
+    printf("error: vffilter options are name=value, got %s\n", opt);
+    return 1;
+  }
+
+  *eq = '\0';
+  const char *name = opt;
+  const long long v = atoll(eq + 1);
+
+  if (!strcmp(name, "dedupe")) cfg->dedupe = v != 0;
+  else if (!strcmp(name, "check")) cfg->drop_check = v != 0;
+  else if (!strcmp(name, "tactical")) cfg->drop_tactical = v != 0;
+  else if (!strcmp(name, "max_score")) cfg->max_score = (int)v;
+  else if (!strcmp(name, "bloom") && v >= 0 && v <= 65536) cfg->bloom_mb = (int)v;
+  else if (!strcmp(name, "shards") && v >= 1 && v <= VFF_MAX_SHARDS) cfg->shards = (int)v;
+  else if (!strcmp(name, "seed")) cfg->seed = (uint64_t)v;
+  else {
+    printf("error: bad vffilter option %s\n", name);
+    return 1;
+  }
+
+  return 0;
+
+}
+
+// --- dedupe ---
+
+// a concurrent bloom filter; 1 if hash was (probably) seen before. two
+// threads inserting the same position at once may both see it as new
+static int vff_seen(VffShared *vs, const uint64_t hash) {
+
+  const uint64_t step = (hash >> 32 | hash << 32) | 1;
+  int seen = 1;
+
+  for (int i = 0; i < VFF_BLOOM_PROBES; i++) {
+    const uint64_t bit = (hash + i * step) & vs->bloom_mask;
+    const uint64_t mask = 1ULL << (bit & 63);
+    if (!(atomic_fetch_or_explicit(&vs->bloom[bit >> 6], mask, memory_order_relaxed) & mask))
+      seen = 0;
+  }
+
+  return seen;
+
+}
+
+// bloom filter bytes for the input, a power of two; at least 1 MB
+static uint64_t vff_bloom_bytes(const VffShared *vs) {
+
+  if (vs->cfg.bloom_mb)
+    return (uint64_t)vs->cfg.bloom_mb << 20;
+
+  uint64_t bytes = 1 << 20;
+
+  while (bytes * 8 < vs->num_positions * VFF_BLOOM_BITS && bytes < (1ULL << 36))
+    bytes *= 2;
+
+  return bytes;
+
+}
+
+// chance a new position reads as seen once n positions are in the filter
+static double vff_bloom_rate(const VffShared *vs, const uint64_t n) {
+
+  const double bits = (double)(vs->bloom_mask + 1);
+
+  return pow(1.0 - exp(-(double)VFF_BLOOM_PROBES * n / bits), VFF_BLOOM_PROBES);
+
+}
+
+// --- output ---
+
+static void vff_flush(VffShard *sh) {
+
+  if (sh->len && fwrite(sh->buf, 1, sh->len, sh->fp) != sh->len)
+    printf("error: vffilter short write\n");
+
+  sh->len = 0;
+
+}
+
+// a run of kept positions goes to a random shard as one viriformat game
+static void vff_emit(VffWorker *w, const uint8_t *run, const size_t len) {
+
+  VffShared *vs = w->shared;
+  VffShard *sh = &vs->shards[vff_rand(&w->rng) % vs->cfg.shards];
+
+  pthread_mutex_lock(&sh->lock);
+
+  if (sh->len + len > VFF_SHARD_BUF)
+    vff_flush(sh);
+
+  memcpy(sh->buf + sh->len, run, len);
+  sh->len += len;
+
+  pthread_mutex_unlock(&sh->lock);
+
+  w->runs++;
+
+}
+
+// --- filtering ---
+
+static int vff_drop(VffWorker *w, const Position *pos, const move_t move, const int score) {
+
+  const VffConfig *cfg = &w->shared->cfg;
+  const int stm = pos->stm;
+
+  if (cfg->drop_check && is_attacked(pos, bsf(pos->all[piece_index(KING, stm)]), stm ^ 1))
+    return DROP_CHECK;
+
+  if (cfg->drop_tactical && (move & (MOVE_FLAG_CAPTURE | MOVE_FLAG_EPCAPTURE | MOVE_FLAG_PROMOTE)))
+    return DROP_TACTICAL;
+
+  if (abs(score) > cfg->max_score)
+    return DROP_SCORE;
+
+  // last, so only otherwise kept positions fill the filter
+  if (cfg->dedupe && vff_seen(w->shared, pos->hash))
+    return DROP_DUPLICATE;
+
+  return -1;
+
+}
+
+// replay one game; consecutive kept positions are written as one game
+// starting from the first of them
+static void vff_game(VffWorker *w, const uint8_t *rec, const size_t len) {
+
+  const int num_moves = (int)((len - VIRI_BOARD_BYTES) / VIRI_MOVE_BYTES) - 1;
+  const uint8_t wdl = rec[30];
+  uint8_t run[VFF_MAX_GAME];
+  size_t run_len = 0;
+  Position pos;
+  uint16_t fullmove;
+
+  w->games++;
+  w->positions += num_moves;
+
+  if (num_moves > 1024 || packed_board_to_pos(rec, &pos)) {
+    w->dropped[DROP_BAD] += num_moves;
+    return;
+  }
+
+  memcpy(&fullmove, rec + 26, 2);
+
+  for (int i = 0; i < num_moves; i++) {
+
+    ViriMove vm;
+    memcpy(&vm, rec + VIRI_BOARD_BYTES + i * VIRI_MOVE_BYTES, VIRI_MOVE_BYTES);
+
+    // this and every later position of the game are lost
+    const move_t move = viri_to_move(&pos, vm.move);
+    if (!move) {
+      w->dropped[DROP_BAD] += num_moves - i;
+      break;
+    }
+
+    const int reason = vff_drop(w, &pos, move, vm.score);
+
+    if (reason >= 0) {
+      w->dropped[reason]++;
+      if (run_len) {
+        memset(run + run_len, 0, VIRI_MOVE_BYTES);
+        vff_emit(w, run, run_len + VIRI_MOVE_BYTES);
+        run_len = 0;
+      }
+    }
+    else {
+      if (!run_len) {
+        pos_to_packed_board(&pos, run, wdl, fullmove, vm.score);
+        run_len = VIRI_BOARD_BYTES;
+      }
+      memcpy(run + run_len, &vm, VIRI_MOVE_BYTES);
+      run_len += VIRI_MOVE_BYTES;
+      w->kept++;
+    }
+
+    fullmove += pos.stm == BLACK;
+    make_move_pos(&pos, move);
+
+  }
+
+  if (run_len) {
+    memset(run + run_len, 0, VIRI_MOVE_BYTES);
+    vff_emit(w, run, run_len + VIRI_MOVE_BYTES);
+  }
+
+}
+
+// --- passes ---
+
+static int vff_add_chunk(VffShared *vs, const int file, const size_t begin, const size_t end) {
+
+  pthread_mutex_lock(&vs->chunk_lock);
+
+  if (vs->num_chunks == vs->cap_chunks) {
+    const int cap = vs->cap_chunks ? vs->cap_chunks * 2 : 256;
+    VffChunk *grown = realloc(vs->chunks, cap * sizeof(VffChunk));
+    if (!grown) {
+      pthread_mutex_unlock(&vs->chunk_lock);
+      return 1;
+    }
+    vs->chunks = grown;
+    vs->cap_chunks = cap;
+  }
+
+  vs->chunks[vs->num_chunks++] = (VffChunk){file, begin, end};
+
+  pthread_mutex_unlock(&vs->chunk_lock);
+
+  return 0;
+
+}
+
+// pass 1: cut every file into chunks of whole games
+static void *vff_scan_worker(void *arg) {
+
+  VffShared *vs = ((VffWorker *)arg)->shared;
+  int f;
+
+  while ((f = atomic_fetch_add(&vs->next_file, 1)) < vs->num_files) {
+
+    const MappedFile *mf = &vs->files[f];
+    size_t offset = 0;
+    size_t begin = 0;
+    int games = 0;
+    uint64_t positions = 0;
+
+    while (offset < mf->size) {
+
+      const size_t end = viri_record_end(mf->data, mf->size, offset);
+      if (!end) {
+        printf("error: %s offset %llu: truncated record, rest of file skipped\n",
+          vs->names[f], (unsigned long long)offset);
+        break;
+      }
+
+      positions += (end - offset - VIRI_BOARD_BYTES) / VIRI_MOVE_BYTES - 1;
+      offset = end;
+
+      if (++games == VFF_CHUNK_GAMES) {
+        vff_add_chunk(vs, f, begin, offset);
+        begin = offset;
+        games = 0;
+      }
+
+    }
+
+    if (offset > begin)
+      vff_add_chunk(vs, f, begin, offset);
+
+    atomic_fetch_add(&vs->num_positions, positions);
+
+  }
+
+  return NULL;
+
+}
+
+// pass 2: filter every game into the shards
+static void *vff_filter_worker(void *arg) {
+
+  VffWorker *w = (VffWorker *)arg;
+  VffShared *vs = w->shared;
+  int c;
+
+  while ((c = atomic_fetch_add(&vs->next_chunk, 1)) < vs->num_chunks) {
+
+    const VffChunk *ch = &vs->chunks[c];
+    const MappedFile *mf = &vs->files[ch->file];
+    size_t offset = ch->begin;
+
+    while (offset < ch->end) {
+      const size_t end = viri_record_end(mf->data, ch->end, offset);
+      vff_game(w, mf->data + offset, end - offset);
+      offset = end;
+    }
+
+  }
+
+  return NULL;
+
+}
+
+static void vff_shard_name(const VffShared *vs, const int i, char *buf, const size_t size, const int tmp) {
+  snprintf(buf, size, "%s/filtered_%d.vf%s", vs->out_dir, i, tmp ? ".tmp" : "");
+}
+
+// pass 3: shuffle the games within each shard, one shard per thread at a
+// time; a shard has to fit in memory
+static void *vff_shuffle_worker(void *arg) {
+
+  VffWorker *w = (VffWorker *)arg;
+  VffShared *vs = w->shared;
+  int s;
+
+  while ((s = atomic_fetch_add(&vs->next_shard, 1)) < vs->cfg.shards) {
+
+    char tmp[1024];
+    char path[1024];
+    MappedFile mf;
+    vff_shard_name(vs, s, tmp, sizeof(tmp), 1);
+    vff_shard_name(vs, s, path, sizeof(path), 0);
+
+    if (map_file(&mf, tmp)) {
+      // nothing was written to this shard
+      remove(tmp);
+      FILE *fp = fopen(path, "wb");
+      if (fp)
+        fclose(fp);
+      continue;
+    }
+
+    size_t cap = 1024;
+    size_t n = 0;
+    size_t *offsets = malloc(cap * sizeof(size_t));
+
+    for (size_t offset = 0; offsets && offset < mf.size; ) {
+      if (n == cap) {
+        cap *= 2;
+        size_t *grown = realloc(offsets, cap * sizeof(size_t));
+        if (!grown) {
+          free(offsets);
+          offsets = NULL;
+          break;
+        }
+        offsets = grown;
+      }
+      offsets[n++] = offset;
+      offset = viri_record_end(mf.data, mf.size, offset);
+    }
+
+    FILE *fp = offsets ? fopen(path, "wb") : NULL;
+
+    if (!fp) {
+      printf("error: cannot shuffle %s\n", tmp);
+      free(offsets);
+      unmap_file(&mf);
+      continue;
+    }
+
+    setvbuf(fp, NULL, _IOFBF, VFF_SHARD_BUF);
+
+    for (size_t i = n; i > 1; i--) {
+      const size_t j = vff_rand(&w->rng) % i;
+      const size_t t = offsets[i - 1];
+      offsets[i - 1] = offsets[j];
+      offsets[j] = t;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+      const size_t end = viri_record_end(mf.data, mf.size, offsets[i]);
+      fwrite(mf.data + offsets[i], 1, end - offsets[i], fp);
+    }
+
+    fclose(fp);
+    free(offsets);
+    unmap_file(&mf);
+    remove(tmp);
+
+  }
+
+  return NULL;
+
+}
+
+static void vff_run(VffWorker *workers, const int threads, void *(*fn)(void *)) {
+
+  pthread_t handles[VFF_MAX_THREADS];
+
+  for (int i = 1; i < threads; i++)
+    pthread_create(&handles[i], NULL, fn, &workers[i]);
+
+  fn(&workers[0]);
+
+  for (int i = 1; i < threads; i++)
+    pthread_join(handles[i], NULL);
+
+}
+
+// --- main ---
+
+static void vff_cleanup(VffShared *vs) {
+
+  if (vs->shards) {
+    for (int i = 0; i < vs->cfg.shards; i++) {
+      if (vs->shards[i].fp)
+        fclose(vs->shards[i].fp);
+      free(vs->shards[i].buf);
+      pthread_mutex_destroy(&vs->shards[i].lock);
+    }
+  }
+
+  if (vs->files) {
+    for (int i = 0; i < vs->num_files; i++)
+      unmap_file(&vs->files[i]);
+  }
+
+  pthread_mutex_destroy(&vs->chunk_lock);
+  free(vs->shards);
+  free(vs->files);
+  free(vs->chunks);
+  free((void *)vs->bloom);
+  viri_free_list(vs->names, vs->num_files);
+
+}
+
+void vffilter(const char *in_path, const char *out_dir, int threads, int num_opts, char **opts) {
+
+  static VffWorker workers[VFF_MAX_THREADS];
+  VffShared vs;
+
+  if (threads < 1) threads = 1;
+  if (threads > VFF_MAX_THREADS) threads = VFF_MAX_THREADS;
+
+  memset(&vs, 0, sizeof(vs));
+  vs.out_dir = out_dir;
+  vs.cfg = (VffConfig){
+    .dedupe = VFF_DEDUPE,
+    .drop_check = VFF_DROP_CHECK,
+    .drop_tactical = VFF_DROP_TACTICAL,
+    .max_score = VFF_MAX_SCORE,
+    .bloom_mb = VFF_BLOOM_MB,
+    .shards = VFF_SHARDS,
+    .seed = time_ms(),
+  };
+
+  for (int i = 0; i < num_opts; i++) {
+    if (vff_set_option(&vs.cfg, opts[i]))
+      return;
+  }
+
+  pthread_mutex_init(&vs.chunk_lock, NULL);
+
+  vs.num_files = viri_list_files(in_path, &vs.names);
+  if (vs.num_files <= 0) {
+    printf("error: no .vf files in %s\n", in_path);
+    vs.num_files = 0;
+    vff_cleanup(&vs);
+    return;
+  }
+
+  vs.files = calloc(vs.num_files, sizeof(MappedFile));
+  vs.shards = calloc(vs.cfg.shards, sizeof(VffShard));
+
+  if (!vs.files || !vs.shards) {
+    printf("error: vffilter out of memory\n");
+    vff_cleanup(&vs);
+    return;
+  }
+
+  for (int i = 0; i < vs.cfg.shards; i++) {
+    char path[1024];
+    VffShard *sh = &vs.shards[i];
+    pthread_mutex_init(&sh->lock, NULL);
+    vff_shard_name(&vs, i, path, sizeof(path), 1);
+    sh->fp = fopen(path, "wb");
+    sh->buf = malloc(VFF_SHARD_BUF);
+    if (!sh->fp || !sh->buf) {
+      printf("error: cannot open %s\n", path);
+      vff_cleanup(&vs);
+      return;
+    }
+  }
+
+  for (int i = 0; i < vs.num_files; i++) {
+    if (map_file(&vs.files[i], vs.names[i]))
+      printf("error: cannot read %s\n", vs.names[i]);
+  }
+
+  for (int i = 0; i < threads; i++) {
+    memset(&workers[i], 0, sizeof(VffWorker));
+    workers[i].shared = &vs;
+    workers[i].id = i;
+    workers[i].rng = (vs.cfg.seed + i) * 0x9E3779B97F4A7C15ULL | 1;
+  }
+
+  const uint64_t start_ms = time_ms();
+
+  printf("vffilter: %d files -> %d shards in %s, %d threads\n", vs.num_files, vs.cfg.shards, out_dir, threads);
+  fflush(stdout);
+
+  vff_run(workers, threads, vff_scan_worker);
+
+  // the filter is sized once the input's position count is known
+  if (vs.cfg.dedupe) {
+
+    const uint64_t bloom_bytes = vff_bloom_bytes(&vs);
+    vs.bloom = calloc(1, bloom_bytes);
+    vs.bloom_mask = bloom_bytes * 8 - 1;
+
+    if (!vs.bloom) {
+      printf("error: cannot allocate a %llu MB bloom filter, set a smaller one with bloom=MB\n",
+        (unsigned long long)(bloom_bytes >> 20));
+      vff_cleanup(&vs);
+      return;
+    }
+
+    const double rate = vff_bloom_rate(&vs, vs.num_positions);
+
+    printf("vffilter: %llu positions, bloom filter %llu MB, at most %.3f%% false duplicates\n",
+      (unsigned long long)vs.num_positions, (unsigned long long)(bloom_bytes >> 20), 100.0 * rate);
+
+    if (rate > VFF_BLOOM_WARN)
+      printf("warning: the bloom filter is overloaded and will drop unique positions, raise bloom=MB\n");
+
+    fflush(stdout);
+
+  }
+
+  vff_run(workers, threads, vff_filter_worker);
+
+  for (int i = 0; i < vs.cfg.shards; i++) {
+    vff_flush(&vs.shards[i]);
+    fclose(vs.shards[i].fp);
+    vs.shards[i].fp = NULL;
+  }
+
+  vff_run(workers, threads, vff_shuffle_worker);
+
+  VffWorker total;
+  memset(&total, 0, sizeof(total));
+
+  for (int i = 0; i < threads; i++) {
+    total.games += workers[i].games;
+    total.positions += workers[i].positions;
+    total.kept += workers[i].kept;
+    total.runs += workers[i].runs;
+    for (int j = 0; j < NUM_DROPS; j++)
+      total.dropped[j] += workers[i].dropped[j];
+  }
+
+  printf("vffilter: %llu games %llu positions, kept %llu (%.1f%%) as %llu games, elapsed %llu\n",
+    (unsigned long long)total.games,
+    (unsigned long long)total.positions,
+    (unsigned long long)total.kept,
+    total.positions ? 100.0 * total.kept / total.positions : 0.0,
+    (unsigned long long)total.runs,
+    (unsigned long long)(time_ms() - start_ms));
+
+  for (int j = 0; j < NUM_DROPS; j++)
+    printf("vffilter: dropped %llu %s\n", (unsigned long long)total.dropped[j], drop_names[j]);
+
+  vff_cleanup(&vs);
+
+}
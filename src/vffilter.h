@@ -0,0 +1,6 @@
+#ifndef VFFILTER_H
+#define VFFILTER_H
+
+void vffilter(const char *in_path, const char *out_dir, int threads, int num_opts, char **opts);
+
+#endif
@@ -0,0 +1,379 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "vfstat.h"
+#include "types.h"
+#include "builtins.h"
+#include "pos.h"
+#include "move.h"
+#include "makemove.h"
+#include "mapfile.h"
+#include "viri.h"
+
+#define VF_MAX_THREADS   256
+#define VF_CHUNK_GAMES   4096  // games per work item
+#define VF_MAX_ERRORS    20    // reported individually
+#define VF_LEN_BUCKET    16    // game length histogram bucket width
+#define VF_LEN_BUCKETS   33    // the last one takes everything longer
+
+typedef struct {
+  int file;
+  size_t begin;
+  size_t end;
+} VfChunk;
+
+typedef struct {
+  int file;
+  size_t offset;
+  char reason[48];
+} VfError;
+
+typedef struct {
+  uint64_t games;
+  uint64_t positions;
+  uint64_t wdl[3];
+  uint64_t length[VF_LEN_BUCKETS];
+  uint64_t pieces[33];
+  uint64_t corrupt;
+  uint64_t truncated;
+} VfStats;
+
+typedef struct {
+  char **names;
+  MappedFile *files;
+  int num_files;
+  _Atomic int next_file;
+  VfChunk *chunks;
+  int num_chunks;
+  int cap_chunks;
+  _Atomic int next_chunk;
+  VfError errors[VF_MAX_ERRORS];
+  int num_errors;
+  pthread_mutex_t lock;
+} VfShared;
+
+typedef struct {
+  VfShared *shared;
+  VfStats stats;
+} VfWorker;
+
+static void vf_error(VfShared *vs, VfStats *st, const int file, const size_t offset, const char *reason) {
+
+  pthread_mutex_lock(&vs->lock);
+
+  if (vs->num_errors < VF_MAX_ERRORS) {
+    VfError *e = &vs->errors[vs->num_errors++];
+    e->file = file;
+    e->offset = offset;
+    snprintf(e->reason, sizeof(e->reason), "%s", reason);
+  }
+
+  pthread_mutex_unlock(&vs->lock);
+
+  st->corrupt++;
+
+}
+
+static int vf_add_chunk(VfShared *vs, const int file, const size_t begin, const size_t end) {
+
+  pthread_mutex_lock(&vs->lock);
+
+  if (vs->num_chunks == vs->cap_chunks) {
+    const int cap = vs->cap_chunks ? vs->cap_chunks * 2 : 256;
+    VfChunk *grown = realloc(vs->chunks, cap * sizeof(VfChunk));
+    if (!grown) {
+      pthread_mutex_unlock(&vs->lock);
+      return 1;
+    }
+    vs->chunks = grown;
+    vs->cap_chunks = cap;
+  }
+
+  vs->chunks[vs->num_chunks++] = (VfChunk){file, begin, end};
+
+  pthread_mutex_unlock(&vs->lock);
+
+  return 0;
+
+}
+
+// pass 1: find the record boundaries of whole files and cut them into
+// chunks of games; a file that ends inside a record is flagged there
+static void *vf_scan_worker(void *arg) {
+
+  VfWorker *w = (VfWorker *)arg;
+  VfShared *vs = w->shared;
+  int f;
+
+  while ((f = atomic_fetch_add(&vs->next_file, 1)) < vs->num_files) {
+
+    const MappedFile *mf = &vs->files[f];
+    size_t offset = 0;
+    size_t begin = 0;
+    int games = 0;
+
+    while (offset < mf->size) {
+
+      const size_t end = viri_record_end(mf->data, mf->size, offset);
+
+      if (!end) {
+        vf_error(vs, &w->stats, f, offset, "truncated record");
+        w->stats.corrupt--;
+        w->stats.truncated++;
+        break;
+      }
+
+      offset = end;
+
+      if (++games == VF_CHUNK_GAMES) {
+        vf_add_chunk(vs, f, begin, offset);
+        begin = offset;
+        games = 0;
+      }
+
+    }
+
+    if (offset > begin)
+      vf_add_chunk(vs, f, begin, offset);
+
+  }
+
+  return NULL;
+
+}
+
+// replay one game; positions are only counted for games that replay
+// cleanly
+static void vf_check_game(VfShared *vs, VfStats *st, const int file, const uint8_t *rec, const size_t offset, const size_t end) {
+
+  Position pos;
+  uint64_t pieces[33] = {0};
+  char reason[48];
+  const int num_moves = (int)((end - offset - VIRI_BOARD_BYTES) / VIRI_MOVE_BYTES) - 1;
+  const int wdl = rec[30];
+
+  if (wdl > VIRI_WDL_WHITE_WIN) {
+    vf_error(vs, st, file, offset, "bad wdl");
+    return;
+  }
+
+  if (packed_board_to_pos(rec, &pos)) {
+    vf_error(vs, st, file, offset, "bad board");
+    return;
+  }
+
+  for (int i = 0; i < num_moves; i++) {
+
+    ViriMove vm;
+    memcpy(&vm, rec + VIRI_BOARD_BYTES + i * VIRI_MOVE_BYTES, VIRI_MOVE_BYTES);
+
+    const move_t move = viri_to_move(&pos, vm.move);
+    if (!move) {
+      snprintf(reason, sizeof(reason), "illegal move at ply %d", i);
+      vf_error(vs, st, file, offset, reason);
+      return;
+    }
+
+    pieces[popcount(pos.occupied)]++;
+    make_move_pos(&pos, move);
+
+  }
+
+  st->games++;
+  st->positions += num_moves;
+  st->wdl[wdl]++;
+
+  const int bucket = num_moves / VF_LEN_BUCKET;
+  st->length[bucket < VF_LEN_BUCKETS ? bucket : VF_LEN_BUCKETS - 1]++;
+
+  for (int i = 0; i <= 32; i++)
+    st->pieces[i] += pieces[i];
+
+}
+
+// pass 2: replay every game of a chunk through the move generator
+static void *vf_check_worker(void *arg) {
+
+  VfWorker *w = (VfWorker *)arg;
+  VfShared *vs = w->shared;
+  int c;
+
+  while ((c = atomic_fetch_add(&vs->next_chunk, 1)) < vs->num_chunks) {
+
+    const VfChunk *ch = &vs->chunks[c];
+    const MappedFile *mf = &vs->files[ch->file];
+    size_t offset = ch->begin;
+
+    while (offset < ch->end) {
+      const size_t end = viri_record_end(mf->data, ch->end, offset);
+      vf_check_game(vs, &w->stats, ch->file, mf->data + offset, offset, end);
+      offset = end;
+    }
+
+  }
+
+  return NULL;
+
+}
+
+static void vf_run(VfWorker *workers, const int threads, void *(*fn)(void *)) {
+
+  pthread_t handles[VF_MAX_THREADS];
+
+  for (int i = 1; i < threads; i++)
+    pthread_create(&handles[i], NULL, fn, &workers[i]);
+
+  fn(&workers[0]);
+
+  for (int i = 1; i < threads; i++)
+    pthread_join(handles[i], NULL);
+
+}
+
+static int cmp_errors(const void *a, const void *b) {
+
+  const VfError *x = a;
+  const VfError *y = b;
+
+  if (x->file != y->file)
+    return x->file - y->file;
+
+  return (x->offset > y->offset) - (x->offset < y->offset);
+
+}
+
+static void vf_print_bar(const char *label, const uint64_t count, const uint64_t total) {
+
+  const int width = total ? (int)(50 * count / total) : 0;
+  char bar[51];
+
+  memset(bar, '#', width);
+  bar[width] = '\0';
+
+  printf("  %-9s %12llu %5.1f%% %s\n", label, (unsigned long long)count,
+    total ? 100.0 * count / total : 0.0, bar);
+
+}
+
+static void vf_report(const VfShared *vs, const VfStats *st, const uint64_t bytes, const uint64_t elapsed_ms) {
+
+  char label[16];
+
+  printf("files %d bytes %llu elapsed %llu\n", vs->num_files,
+    (unsigned long long)bytes, (unsigned long long)elapsed_ms);
+  printf("games %llu positions %llu (%.1f per game, %.2f bytes per position)\n",
+    (unsigned long long)st->games,
+    (unsigned long long)st->positions,
+    st->games ? (double)st->positions / st->games : 0.0,
+    st->positions ? (double)bytes / st->positions : 0.0);
+  printf("corrupt %llu truncated %llu\n",
+    (unsigned long long)st->corrupt, (unsigned long long)st->truncated);
+
+  printf("wdl\n");
+  vf_print_bar("white", st->wdl[VIRI_WDL_WHITE_WIN], st->games);
+  vf_print_bar("draw", st->wdl[VIRI_WDL_DRAW], st->games);
+  vf_print_bar("black", st->wdl[VIRI_WDL_BLACK_WIN], st->games);
+
+  printf("game length (plies)\n");
+  for (int i = 0; i < VF_LEN_BUCKETS; i++) {
+    if (!st->length[i])
+      continue;
+    if (i == VF_LEN_BUCKETS - 1)
+      snprintf(label, sizeof(label), "%d+", i * VF_LEN_BUCKET);
+    else
+      snprintf(label, sizeof(label), "%d-%d", i * VF_LEN_BUCKET, (i + 1) * VF_LEN_BUCKET - 1);
+    vf_print_bar(label, st->length[i], st->games);
+  }
+
+  printf("pieces per position\n");
+  for (int i = 32; i >= 2; i--) {
+    if (!st->pieces[i])
+      continue;
+    snprintf(label, sizeof(label), "%d", i);
+    vf_print_bar(label, st->pieces[i], st->positions);
+  }
+
+  for (int i = 0; i < vs->num_errors; i++)
+    printf("error: %s offset %llu: %s\n", vs->names[vs->errors[i].file],
+      (unsigned long long)vs->errors[i].offset, vs->errors[i].reason);
+
+  if (st->corrupt + st->truncated > (uint64_t)vs->num_errors)
+    printf("error: %llu more not shown\n",
+      (unsigned long long)(st->corrupt + st->truncated - vs->num_errors));
+
+}
+
+void vfstat(const char *path, int threads) {
+
+  static VfWorker workers[VF_MAX_THREADS];
+  VfShared vs;
+  VfStats total;
+  uint64_t bytes = 0;
+
+  if (threads < 1) threads = 1;
+  if (threads > VF_MAX_THREADS) threads = VF_MAX_THREADS;
+
+  memset(&vs, 0, sizeof(vs));
+  memset(&total, 0, sizeof(total));
+
+  vs.num_files = viri_list_files(path, &vs.names);
+  if (vs.num_files <= 0) {
+    printf("error: no .vf files in %s\n", path);
+    return;
+  }
+
+  vs.files = calloc(vs.num_files, sizeof(MappedFile));
+  if (!vs.files) {
+    viri_free_list(vs.names, vs.num_files);
+    return;
+  }
+
+  for (int i = 0; i < vs.num_files; i++) {
+    if (map_file(&vs.files[i], vs.names[i]))
+      printf("error: cannot read %s\n", vs.names[i]);
+    bytes += vs.files[i].size;
+  }
+
+  pthread_mutex_init(&vs.lock, NULL);
+
+  for (int i = 0; i < threads; i++) {
+    memset(&workers[i], 0, sizeof(VfWorker));
+    workers[i].shared = &vs;
+  }
+
+  const uint64_t start_ms = time_ms();
+
+  vf_run(workers, threads, vf_scan_worker);
+  vf_run(workers, threads, vf_check_worker);
+
+  for (int i = 0; i < threads; i++) {
+    const VfStats *st = &workers[i].stats;
+    total.games += st->games;
+    total.positions += st->positions;
+    total.corrupt += st->corrupt;
+    total.truncated += st->truncated;
+    for (int j = 0; j < 3; j++)
+      total.wdl[j] += st->wdl[j];
+    for (int j = 0; j < VF_LEN_BUCKETS; j++)
+      total.length[j] += st->length[j];
+    for (int j = 0; j <= 32; j++)
+      total.pieces[j] += st->pieces[j];
+  }
+
+  qsort(vs.errors, vs.num_errors, sizeof(VfError), cmp_errors);
+
+  vf_report(&vs, &total, bytes, time_ms() - start_ms);
+
+  pthread_mutex_destroy(&vs.lock);
+
+  for (int i = 0; i < vs.num_files; i++)
+    unmap_file(&vs.files[i]);
+
+  free(vs.files);
+  free(vs.chunks);
+  viri_free_list(vs.names, vs.num_files);
+
+}
@@ -0,0 +1,6 @@
+#ifndef VFSTAT_H
+#define VFSTAT_H
+
+void vfstat(const char *path, int threads);
+
+#endif
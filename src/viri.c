@@ -0,0 +1,352 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#ifdef _WIN32
+  #include <windows.h>
+#else
+  #include <dirent.h>
+  #include <sys/stat.h>
+#endif
+#include "viri.h"
+#include "types.h"
+#include "builtins.h"
+#include "pos.h"
+#include "move.h"
+#include "movegen.h"
+#include "zobrist.h"
+
+// --- PackedBoard (32 bytes) ---
+
+// eval is white relative, like the move scores
+void pos_to_packed_board(const Position *pos, uint8_t *buf, const uint8_t wdl, const int fullmove, const int eval) {
+
+  memset(buf, 0, 32);
+
+  // bytes 0-7: occupancy
+  uint64_t occ = pos->occupied;
+  memcpy(buf, &occ, 8);
+
+  // bytes 8-23: nibble-packed pieces
+  // walk set bits of occupancy, for each encode a 4-bit nibble
+  uint64_t tmp = occ;
+  int idx = 0;
+  while (tmp) {
+    int sq = bsf(tmp);
+    tmp &= tmp - 1;
+
+    uint8_t piece = pos->board[sq];
+    int color = piece_colour(piece);
+    int type = piece_type(piece);
+
+    // unmoved rook detection
+    if (type == ROOK) {
+      if (sq == H1 && (pos->rights & WHITE_RIGHTS_KING))  type = 6;
+      if (sq == A1 && (pos->rights & WHITE_RIGHTS_QUEEN)) type = 6;
+      if (sq == H8 && (pos->rights & BLACK_RIGHTS_KING))  type = 6;
+      if (sq == A8 && (pos->rights & BLACK_RIGHTS_QUEEN)) type = 6;
+    }
+
+    uint8_t nibble = (color << 3) | type;
+    int byte_idx = 8 + (idx / 2);
+    if (idx & 1)
+      buf[byte_idx] |= nibble << 4;
+    else
+      buf[byte_idx] = nibble;
+    idx++;
+  }
+
+  // byte 24: stm_ep_square
+  uint8_t ep = pos->ep ? pos->ep : 64;
+  buf[24] = (pos->stm << 7) | (ep & 0x7F);
+
+  // byte 25: halfmove clock
+  buf[25] = pos->hmc;
+
+  // bytes 26-27: fullmove number
+  const uint16_t fm = (uint16_t)fullmove;
+  memcpy(buf + 26, &fm, 2);
+
+  // bytes 28-29: eval
+  const int16_t ev = (int16_t)eval;
+  memcpy(buf + 28, &ev, 2);
+
+  // byte 30: wdl
+  buf[30] = wdl;
+
+  // byte 31: extra (0)
+
+}
+
+// the inverse of pos_to_packed_board; 1 if the board is not a legal
+// position (bad nibble, missing king, pawn on a back rank, bad ep square or
+// the side to move able to take the king)
+int packed_board_to_pos(const uint8_t *buf, Position *pos) {
+
+  memset(pos, 0, sizeof(Position));
+
+  for (int i = 0; i < 64; i++)
+    pos->board[i] = EMPTY;
+
+  uint64_t occ;
+  memcpy(&occ, buf, 8);
+
+  if (popcount(occ) > 32)
+    return 1;
+
+  uint64_t unmoved_rooks = 0;
+  uint64_t tmp = occ;
+  int idx = 0;
+
+  while (tmp) {
+    int sq = bsf(tmp);
+    tmp &= tmp - 1;
+
+    const uint8_t nibble = (buf[8 + idx / 2] >> ((idx & 1) * 4)) & 0xF;
+    const int colour = nibble >> 3;
+    int type = nibble & 7;
+    idx++;
+
+    if (type > 6)
+      return 1;
+
+    if (type == 6) {
+      unmoved_rooks |= 1ULL << sq;
+      type = ROOK;
+    }
+
+    if (type == PAWN && (sq < 8 || sq >= 56))
+      return 1;
+
+    const int index = piece_index(type, colour);
+    pos->all[index] |= 1ULL << sq;
+    pos->colour[colour] |= 1ULL << sq;
+    pos->board[sq] = index;
+  }
+
+  pos->occupied = occ;
+
+  if (popcount(pos->all[WKING]) != 1 || popcount(pos->all[BKING]) != 1)
+    return 1;
+
+  pos->stm = buf[24] >> 7;
+  const int ep = buf[24] & 0x7F;
+
+  if (ep != 64) {
+    const int ep_rank = pos->stm == WHITE ? 5 : 2;
+    if (ep > 63 || ep / 8 != ep_rank)
+      return 1;
+    pos->ep = ep;
+  }
+
+  pos->hmc = buf[25];
+
+  // rights come from the unmoved rooks on the back ranks
+  pos->castling_rook_sq[WHITE][0] = H1;
+  pos->castling_rook_sq[WHITE][1] = A1;
+  pos->castling_rook_sq[BLACK][0] = H8;
+  pos->castling_rook_sq[BLACK][1] = A8;
+
+  for (int colour = WHITE; colour <= BLACK; colour++) {
+
+    const int king_sq = bsf(pos->all[piece_index(KING, colour)]);
+    const uint64_t back_rank = colour == WHITE ? 0xFFULL : 0xFF00000000000000ULL;
+    uint64_t rooks = unmoved_rooks & pos->colour[colour];
+
+    if (rooks & ~back_rank)
+      return 1;
+
+    while (rooks) {
+      const int sq = bsf(rooks);
+      rooks &= rooks - 1;
+      const int side = sq > king_sq ? 0 : 1;
+      pos->castling_rook_sq[colour][side] = sq;
+      pos->rights |= colour == WHITE ? (side ? WHITE_RIGHTS_QUEEN : WHITE_RIGHTS_KING)
+                                     : (side ? BLACK_RIGHTS_QUEEN : BLACK_RIGHTS_KING);
+    }
+
+  }
+
+  // the side that just moved cannot be in check
+  const int opp = pos->stm ^ 1;
+  if (is_attacked(pos, bsf(pos->all[piece_index(KING, opp)]), pos->stm))
+    return 1;
+
+  pos->hash = rebuild_hash(pos);
+
+  return 0;
+
+}
+
+// --- moves ---
+
+uint16_t move_to_viri(move_t move) {
+
+  int from = (move >> 6) & 0x3F;
+  int to = move & 0x3F;
+  int type = VIRI_TYPE_NORMAL;
+  int promo = 0;
+
+  if (move & MOVE_FLAG_EPCAPTURE) {
+    type = VIRI_TYPE_EP;
+  }
+  else if (move & MOVE_FLAG_CASTLE) {
+    type = VIRI_TYPE_CASTLE;
+    // convert king destination to rook square (king-takes-rook)
+    if (to == G1) to = H1;
+    else if (to == C1) to = A1;
+    else if (to == G8) to = H8;
+    else if (to == C8) to = A8;
+  }
+  else if (move & MOVE_FLAG_PROMOTE) {
+    type = VIRI_TYPE_PROMO;
+    // cwtch promo piece: bits 13-12 of flags area = piece type (KNIGHT=1..QUEEN=4)
+    int piece = (move >> 12) & 0x7;
+    promo = piece - 1; // KNIGHT=0, BISHOP=1, ROOK=2, QUEEN=3
+  }
+
+  return (uint16_t)(from | (to << 6) | (promo << 12) | (type << 14));
+
+}
+
+// the legal move encoded as viri_move, or 0 if there is none
+move_t viri_to_move(const Position *pos, const uint16_t viri_move) {
+
+  move_t legal[MAX_MOVES];
+  const int n = gen_legal_moves(pos, legal);
+
+  for (int i = 0; i < n; i++) {
+    if (move_to_viri(legal[i]) == viri_move)
+      return legal[i];
+  }
+
+  return 0;
+
+}
+
+// --- records ---
+
+// offset just past the game record starting at offset, or 0 if the data
+// ends before its terminator
+size_t viri_record_end(const uint8_t *data, const size_t size, const size_t offset) {
+
+  size_t i = offset + VIRI_BOARD_BYTES;
+
+  while (i + VIRI_MOVE_BYTES <= size) {
+    uint32_t entry;
+    memcpy(&entry, data + i, 4);
+    i += VIRI_MOVE_BYTES;
+    if (!entry)
+      return i;
+  }
+
+  return 0;
+
+}
+
+// --- files ---
+
+static int cmp_names(const void *a, const void *b) {
+  return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+static int add_name(char ***names, int *n, int *cap, const char *dir, const char *name) {
+
+  if (*n == *cap) {
+    *cap = *cap ? *cap * 2 : 64;
+    char **grown = realloc(*names, *cap * sizeof(char *));
+    if (!grown)
+      return 1;
+    *names = grown;
+  }
+
+  const size_t len = strlen(dir) + strlen(name) + 2;
+  char *path = malloc(len);
+  if (!path)
+    return 1;
+
+  snprintf(path, len, "%s/%s", dir, name);
+  (*names)[(*n)++] = path;
+
+  return 0;
+
+}
+
+// path itself if it is a file, else the .vf files in it sorted by name;
+// returns the count or -1 if path cannot be read
+int viri_list_files(const char *path, char ***names) {
+
+  int n = 0;
+  int cap = 0;
+  *names = NULL;
+
+#ifdef _WIN32
+
+  const DWORD attr = GetFileAttributesA(path);
+  if (attr == INVALID_FILE_ATTRIBUTES)
+    return -1;
+
+  if (!(attr & FILE_ATTRIBUTE_DIRECTORY)) {
+    *names = malloc(sizeof(char *));
+    if (!*names || !((*names)[0] = _strdup(path)))
+      return -1;
+    return 1;
+  }
+
+  char pattern[1024];
+  snprintf(pattern, sizeof(pattern), "%s\\*.vf", path);
+
+  WIN32_FIND_DATAA fd;
+  HANDLE h = FindFirstFileA(pattern, &fd);
+  if (h != INVALID_HANDLE_VALUE) {
+    do {
+      if (add_name(names, &n, &cap, path, fd.cFileName))
+        break;
+    } while (FindNextFileA(h, &fd));
+    FindClose(h);
+  }
+
+#else
+
+  struct stat st;
+  if (stat(path, &st))
+    return -1;
+
+  if (!S_ISDIR(st.st_mode)) {
+    *names = malloc(sizeof(char *));
+    if (!*names || !((*names)[0] = strdup(path)))
+      return -1;
+    return 1;
+  }
+
+  DIR *d = opendir(path);
+  if (!d)
+    return -1;
+
+  struct dirent *e;
+  while ((e = readdir(d))) {
+    const size_t len = strlen(e->d_name);
+    if (len > 3 && !strcmp(e->d_name + len - 3, ".vf"))
+      if (add_name(names, &n, &cap, path, e->d_name))
+        break;
+  }
+
+  closedir(d);
+
+#endif
+
+  if (n)
+    qsort(*names, n, sizeof(char *), cmp_names);
+
+  return n;
+
+}
+
+void viri_free_list(char **names, const int n) {
+
+  for (int i = 0; i < n; i++)
+    free(names[i]);
+
+  free(names);
+
+}
@@ -0,0 +1,37 @@
+#ifndef VIRI_H
+#define VIRI_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "pos.h"
+#include "move.h"
+
+// viriformat: a 32 byte PackedBoard, one ViriMove per position played from
+// it and a zero ViriMove ending the game
+
+#define VIRI_BOARD_BYTES    32
+#define VIRI_MOVE_BYTES     4
+
+#define VIRI_TYPE_NORMAL    0
+#define VIRI_TYPE_EP        1
+#define VIRI_TYPE_CASTLE    2
+#define VIRI_TYPE_PROMO     3
+
+#define VIRI_WDL_BLACK_WIN  0
+#define VIRI_WDL_DRAW       1
+#define VIRI_WDL_WHITE_WIN  2
+
+typedef struct {
+  uint16_t move;
+  int16_t score;  // white relative
+} ViriMove;
+
+void pos_to_packed_board(const Position *pos, uint8_t *buf, const uint8_t wdl, const int fullmove, const int eval);
+int packed_board_to_pos(const uint8_t *buf, Position *pos);
+uint16_t move_to_viri(move_t move);
+move_t viri_to_move(const Position *pos, const uint16_t viri_move);
+size_t viri_record_end(const uint8_t *data, const size_t size, const size_t offset);
+int viri_list_files(const char *path, char ***names);
+void viri_free_list(char **names, const int n);
+
+#endif
@@ -0,0 +1,247 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "types.h"
+#include "writer.h"
+
+#ifdef _WIN32
+  #include <io.h>
+  #define writer_fsync(fp) _commit(_fileno(fp))
+#else
+  #include <unistd.h>
+  #define writer_fsync(fp) fsync(fileno(fp))
+#endif
+
+// records are pushed whole and the ring head only moves past complete
+// records, so every batch the writer takes ends on a record boundary
+
+// after a short write nothing more goes to any file, so each one stays a
+// prefix of what was pushed and bytes_written only counts what is there
+static void flush_batch(Writer *w, WriterStream *s) {
+
+  if (!s->batch_len)
+    return;
+
+  if (!atomic_load(&w->failed)) {
+    const size_t written = fwrite(s->batch, 1, s->batch_len, s->fp);
+    atomic_fetch_add(&s->bytes_written, written);
+    if (written != s->batch_len) {
+      printf("error: writer short write, %llu of %llu bytes\n",
+        (unsigned long long)written, (unsigned long long)s->batch_len);
+      atomic_store(&w->failed, 1);
+    }
+  }
+
+  s->batch_len = 0;
+
+}
+
+// move whole records from the ring into the batch, return bytes moved
+static size_t drain_ring(Writer *w, WriterStream *s) {
+
+  const uint64_t head = atomic_load_explicit(&s->head, memory_order_acquire);
+  const uint64_t tail = atomic_load_explicit(&s->tail, memory_order_relaxed);
+  size_t avail = (size_t)(head - tail);
+
+  if (!avail)
+    return 0;
+
+  // the batch is as large as the ring so whatever is there always fits
+  // once the batch has been flushed
+  if (s->batch_len + avail > WRITER_BATCH_BYTES)
+    flush_batch(w, s);
+
+  const size_t off = (size_t)(tail & (WRITER_RING_BYTES - 1));
+  const size_t first = avail < WRITER_RING_BYTES - off ? avail : WRITER_RING_BYTES - off;
+
+  memcpy(s->batch + s->batch_len, s->ring + off, first);
+  memcpy(s->batch + s->batch_len + first, s->ring, avail - first);
+  s->batch_len += avail;
+
+  atomic_store_explicit(&s->tail, tail + avail, memory_order_release);
+
+  return avail;
+
+}
+
+static void *writer_loop(void *arg) {
+
+  Writer *w = (Writer *)arg;
+  uint64_t last_flush = time_ms();
+  uint64_t last_sync = last_flush;
+  uint64_t last_checkpoint = last_flush;
+
+  for (;;) {
+
+    // read before draining so nothing pushed ahead of the close is missed
+    const int closing = atomic_load(&w->closing);
+    size_t moved = 0;
+
+    for (int i=0; i < w->num_streams; i++) {
+      WriterStream *s = &w->streams[i];
+      moved += drain_ring(w, s);
+      if (s->batch_len >= WRITER_BATCH_BYTES / 2)
+        flush_batch(w, s);
+    }
+
+    const uint64_t now = time_ms();
+
+    if (closing || now - last_flush >= WRITER_FLUSH_MS) {
+      for (int i=0; i < w->num_streams; i++)
+        flush_batch(w, &w->streams[i]);
+      last_flush = now;
+    }
+
+    if (w->fsync_secs && (closing || now - last_sync >= (uint64_t)w->fsync_secs * 1000)) {
+      for (int i=0; i < w->num_streams; i++)
+        writer_fsync(w->streams[i].fp);
+      last_sync = now;
+    }
+
+    // a checkpoint would vouch for bytes that never reached the file
+    if (w->checkpoint && !atomic_load(&w->failed) && (closing || now - last_checkpoint >= (uint64_t)w->checkpoint_secs * 1000)) {
+      w->checkpoint(w->checkpoint_arg);
+      last_checkpoint = time_ms();
+    }
+
+    if (closing)
+      break;
+
+    if (!moved)
+      sleep_ms(1);
+
+  }
+
+  return NULL;
+
+}
+
+int writer_start(Writer *w, FILE **files, const int num_streams, const int fsync_secs,
+                 const int checkpoint_secs, WriterCheckpoint checkpoint, void *checkpoint_arg) {
+
+  memset(w, 0, sizeof(Writer));
+
+  if (num_streams < 1)
+    return 1;
+
+  // aligned_alloc is missing on windows
+  w->streams_mem = calloc(1, num_streams * sizeof(WriterStream) + 64);
+  if (!w->streams_mem)
+    return 1;
+
+  w->streams = (WriterStream *)(((uintptr_t)w->streams_mem + 63) & ~(uintptr_t)63);
+
+  w->num_streams = num_streams;
+  w->fsync_secs = fsync_secs;
+  w->checkpoint_secs = checkpoint_secs;
+  w->checkpoint = checkpoint;
+  w->checkpoint_arg = checkpoint_arg;
+
+  for (int i=0; i < num_streams; i++) {
+
+    WriterStream *s = &w->streams[i];
+
+    s->ring = malloc(WRITER_RING_BYTES);
+    s->batch = malloc(WRITER_BATCH_BYTES);
+    s->fp = files[i];
+
+    if (!s->ring || !s->batch) {
+      writer_stop(w);
+      return 1;
+    }
+
+    // batches are already large, a stdio buffer would only add a copy
+    setvbuf(s->fp, NULL, _IONBF, 0);
+
+  }
+
+  if (pthread_create(&w->thread, NULL, writer_loop, w)) {
+    writer_stop(w);
+    return 1;
+  }
+
+  w->running = 1;
+
+  return 0;
+
+}
+
+// called by the stream's single producer; waits while the ring is full,
+// returns 1 once a write has failed and the record is dropped
+int writer_push(Writer *w, const int stream, const void *record, const size_t len) {
+
+  WriterStream *s = &w->streams[stream];
+  const uint64_t head = atomic_load_explicit(&s->head, memory_order_relaxed);
+
+  if (atomic_load(&w->failed))
+    return 1;
+
+  while (head + len - atomic_load_explicit(&s->tail, memory_order_acquire) > WRITER_RING_BYTES)
+    sleep_ms(1);
+
+  const size_t off = (size_t)(head & (WRITER_RING_BYTES - 1));
+  const size_t first = len < WRITER_RING_BYTES - off ? len : WRITER_RING_BYTES - off;
+
+  memcpy(s->ring + off, record, first);
+  memcpy(s->ring, (const uint8_t *)record + first, len - first);
+
+  atomic_store_explicit(&s->head, head + len, memory_order_release);
+
+  return 0;
+
+}
+
+// wait until the first bytes pushed to a stream since writer_start are in
+// the file, then fsync it; any thread may call this, and on the writer
+// thread (a checkpoint) the bytes are written directly; returns 1 if a
+// write failed and the bytes will never be there
+int writer_sync(Writer *w, const int stream, const uint64_t bytes) {
+
+  WriterStream *s = &w->streams[stream];
+
+  if (pthread_equal(pthread_self(), w->thread)) {
+    while (!atomic_load(&w->failed) && atomic_load(&s->bytes_written) < bytes) {
+      drain_ring(w, s);
+      flush_batch(w, s);
+    }
+  }
+
+  while (!atomic_load(&w->failed) && atomic_load(&s->bytes_written) < bytes)
+    sleep_ms(1);
+
+  if (atomic_load(&w->failed))
+    return 1;
+
+  writer_fsync(s->fp);
+
+  return 0;
+
+}
+
+// drain every ring, write the final batches, run the last checkpoint and
+// release the buffers; the files stay open and belong to the caller;
+// returns 1 if any write failed
+int writer_stop(Writer *w) {
+
+  if (w->running) {
+    atomic_store(&w->closing, 1);
+    pthread_join(w->thread, NULL);
+    w->running = 0;
+  }
+
+  for (int i=0; i < w->num_streams; i++) {
+    free(w->streams[i].ring);
+    free(w->streams[i].batch);
+  }
+
+  free(w->streams_mem);
+  w->streams_mem = NULL;
+  w->streams = NULL;
+  w->num_streams = 0;
+
+  return atomic_load(&w->failed);
+
+}
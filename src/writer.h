@@ -0,0 +1,51 @@
+#ifndef WRITER_H
+#define WRITER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#define WRITER_RING_BYTES  (1 << 22)  // per stream, power of two
+#define WRITER_BATCH_BYTES (1 << 22)  // per stream, written in one call
+#define WRITER_FLUSH_MS    1000       // max time a complete record waits in a batch
+
+// one producer (a worker) feeding one output file through a lock-free ring;
+// head and tail sit on their own cache lines so a push and a drain do not
+// keep pulling the same line between the two cores
+typedef struct {
+  _Alignas(64) _Atomic uint64_t head;  // bytes pushed, written by the producer
+  uint8_t *ring;
+  _Alignas(64) _Atomic uint64_t tail;  // bytes taken, written by the writer thread
+  uint8_t *batch;
+  size_t batch_len;
+  FILE *fp;
+  _Atomic uint64_t bytes_written;
+} WriterStream;
+
+// called on the writer thread every checkpoint_secs and once more after the
+// final drain, never after a write has failed; it may call writer_sync
+typedef void (*WriterCheckpoint)(void *arg);
+
+typedef struct {
+  WriterStream *streams;
+  void *streams_mem;  // streams are 64 byte aligned inside this
+  int num_streams;
+  int fsync_secs;  // 0 = leave it to the os
+  int checkpoint_secs;
+  WriterCheckpoint checkpoint;
+  void *checkpoint_arg;
+  _Atomic int closing;
+  _Atomic int failed;  // sticky, set by the first short write
+  int running;
+  pthread_t thread;
+} Writer;
+
+int writer_start(Writer *w, FILE **files, const int num_streams, const int fsync_secs,
+                 const int checkpoint_secs, WriterCheckpoint checkpoint, void *checkpoint_arg);
+int writer_push(Writer *w, const int stream, const void *record, const size_t len);
+int writer_sync(Writer *w, const int stream, const uint64_t bytes);
+int writer_stop(Writer *w);
+
+#endif